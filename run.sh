@@ -4,6 +4,22 @@
 # -s Number of sets
 # -c Bytes per set ( = Number of ways x Line Size)
 # -f Tracefile
+# -p Decode the trace on a separate thread
+# -j Number of decode threads (indexed binary traces only)
+# -i Instruction count to start simulating at
+# -S Period:Warming:Detail sampled simulation, lengths in instructions, the statistics cover the detailed intervals only
+# -P Number of chunks simulated in parallel, each warmed with up to -w instructions before it and measured like a sequential run
+# -K Number of threads sharing the sets of the cache
+# -k Save the warm state at the end of the warmup, -r continue from it
+# -m Miss ratio curve for every associativity from a single aligned run
+# -z Collect the hints (-d) as word count histograms per -b Bytes region instead of every eviction
+# -l Threshold Learn the region hints from the evictions of the run itself, no hint file needed
+# -y Halve the learned region counts every this many evictions
+# -M File listing one configuration per line (-s -c -g -a -R), all simulated from one pass over the trace
+# -L Sets:SetSize[:LineSize[:Latency]],... Levels below the cache, closest first
+# -I inclusive, exclusive or noninclusive policy of the levels
+# -R Replacement policy : lru, srrip, brrip, drrip, lfu or random
+# -O Next use file of the optimal replacement policy, written by the first run of a configuration
 # Trace File format
 # Instruction Count \t R/W \t Instruction Pointer \t Effective Address \t Memory Access Size
 
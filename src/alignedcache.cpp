@@ -0,0 +1,259 @@
+/*!
+    \file alignedcache.cpp
+    \brief Source code for the AlignedCache class
+*/
+#include <cstring>
+#include "alignedcache.H"
+#include "encoding.H"
+#include "bitmapkernels.H"
+
+//! AlignedCache Constructor
+/*!
+    \param cS Set Size in words
+    \param mG Line size in Bytes, a power of two
+ */
+AlignedCache::AlignedCache(uint32_t cS, uint32_t mG):
+    CacheSet(cS, mG),
+    lineWords(mG / WORD_SIZE),
+    lineStride(utilWords(mG / WORD_SIZE)),
+    ways(cS / (mG / WORD_SIZE)),
+    used(0),
+    tags(ways + 1),
+    order(ways + 1),
+    insInsert(ways + 1),
+    counters((ways + 1) * lineStride),
+    victim(0, (lineWords - 1) * WORD_SIZE, 0)
+{
+    for(uint32_t k = 0; k <= ways; k++)
+        order[k] = k;
+}
+
+//! Find the LRU position of a line
+/*!
+    \param line Start address of the line
+    \return Position of the line, -1 if the line is not in the set
+ */
+int32_t AlignedCache::find(uint64_t line)
+{
+    const uint64_t* t = tags.data();
+    for(uint32_t k = 0; k < used; k++)
+    {
+        if(t[k] == line)
+            return k;
+    }
+    return -1;
+}
+
+//! Make the line at a LRU position the most recently used one
+void AlignedCache::moveToFront(uint32_t k)
+{
+    if(k == 0)
+        return;
+    uint64_t tag = tags[k];
+    uint32_t way = order[k];
+    memmove(&tags[1], &tags[0], k * sizeof(uint64_t));
+    memmove(&order[1], &order[0], k * sizeof(uint32_t));
+    tags[0] = tag;
+    order[0] = way;
+}
+
+//! Count an access in the counters of a way
+/*!
+    Same as cacheBlock::setAccessPattern and cacheBlock::updateAccessPattern, restricted to the words of the line.
+    \param way Way holding the line
+    \param line Start address of the line
+    \param effectiveAddress Start address of the memory access
+    \param memoryAccessSize Size of the memory access in Bytes
+    \param reset TRUE to clear the counters first, for a newly loaded line
+ */
+void AlignedCache::markAccess(uint32_t way, uint64_t line, uint64_t effectiveAddress, uint32_t memoryAccessSize, bool reset)
+{
+    utilWord* c = &counters[way * lineStride];
+    uint32_t lo, hi;
+    accessWords(line, lineWords, effectiveAddress, memoryAccessSize, lo, hi);
+    if(reset)
+        bitmapOps.set(c, lineWords, lo, hi);
+    else
+        bitmapOps.add(c, lineWords, lo, hi);
+}
+
+//! Evict the least recently used line
+/*!
+    \param insCount The instruction count at the time of eviction
+    \param isPurge TRUE if called at the end of the run
+ */
+void AlignedCache::evictLast(uint64_t insCount, bool isPurge)
+{
+    used--;
+    uint32_t way = order[used];
+    victim.startAddress = tags[used];
+    victim.endAddress = tags[used] + (lineWords - 1) * WORD_SIZE;
+    victim.insInsert = insInsert[way];
+    memcpy(victim.utilizationBitmap, &counters[way * lineStride], lineStride * sizeof(utilWord));
+    data.evict(&victim, insCount, isPurge);
+}
+
+//! Probe the set for a line and load it on a miss
+/*!
+    A miss always loads the whole line from the lower level. The line is inserted at the top of the LRU order, the victim is evicted by evictToFit.
+    \param mb Requested line
+    \param effectiveAddress Start address of the actual access
+    \param memoryAccessSize Size of access in Bytes
+    \return Latency of the operation
+ */
+int32_t AlignedCache::access(memblock mb, uint64_t effectiveAddress, uint32_t memoryAccessSize)
+{
+    data.access();
+    uint64_t line = lineAddress(mb.startAddress);
+    int32_t k = find(line);
+    if(k >= 0)
+    {
+        moveToFront(k);
+        markAccess(order[0], line, effectiveAddress, memoryAccessSize, false);
+        data.hit(NULL);
+        return SET_HIT_ACCESS_LATENCY;
+    }
+
+    // The way after the valid lines is the free one
+    uint32_t way = order[used];
+    memmove(&tags[1], &tags[0], used * sizeof(uint64_t));
+    memmove(&order[1], &order[0], used * sizeof(uint32_t));
+    tags[0] = line;
+    order[0] = way;
+    used++;
+    insInsert[way] = mb.insCount;
+    data.miss(NULL, lineWords);
+    markAccess(way, line, effectiveAddress, memoryAccessSize, true);
+    return SET_MISS_ACCESS_LATENCY;
+}
+
+//! Evict the least recently used lines until the set fits
+/*!
+    \param insCount The instruction count at the time of eviction
+ */
+void AlignedCache::evictToFit(uint64_t insCount)
+{
+    while(used > ways)
+        evictLast(insCount, false);
+}
+
+//! Evict all lines at the end of the simulation run
+/*!
+    \param insCount Latest instruction seen by the set / cachecontroller
+ */
+void AlignedCache::purge(uint64_t insCount)
+{
+    while(used > 0)
+        evictLast(insCount, true);
+}
+
+//! Evict every line overlapping a range of addresses
+/*!
+    The line is moved to the bottom of the LRU order first, so it leaves through evictLast like any other victim.
+    \param startAddress First address of the range
+    \param endAddress Last address of the range
+    \param insCount The instruction count at the time of eviction
+    \return Number of evicted lines
+ */
+uint32_t AlignedCache::invalidate(uint64_t startAddress, uint64_t endAddress, uint64_t insCount)
+{
+    uint32_t evicted = 0;
+    for(uint64_t line = lineAddress(startAddress); line <= endAddress; line += maxGran)
+    {
+        int32_t k = find(line);
+        if(k < 0)
+            continue;
+        uint32_t way = order[k];
+        memmove(&tags[k], &tags[k + 1], (used - 1 - k) * sizeof(uint64_t));
+        memmove(&order[k], &order[k + 1], (used - 1 - k) * sizeof(uint32_t));
+        tags[used - 1] = line;
+        order[used - 1] = way;
+        evictLast(insCount, false);
+        evicted++;
+    }
+    return evicted;
+}
+
+//! Check if every line of a range is in the set
+/*!
+    \param addr Start address of the range
+    \param size Size of the range in Bytes
+    \return TRUE if all lines are present
+ */
+bool AlignedCache::isFullHit(uint64_t addr, uint32_t size)
+{
+    for(uint64_t line = lineAddress(addr); line <= addr + size - 1; line += maxGran)
+    {
+        if(find(line) < 0)
+            return false;
+    }
+    return true;
+}
+
+//! Print debug information
+/*!
+    Prints out the lines of this set in LRU order
+ */
+void AlignedCache::print(void)
+{
+    cout << "Cache Size in Words: " << cacheSize   << endl;
+    cout << "Space Used in Words: " << getWordsInCache() << endl;
+    cout << "----LRU Queue" << endl;
+    for(uint32_t k = 0; k < used; k++)
+    {
+        cout << k << ". SA: " << hex << tags[k] << " EA: " << tags[k] + (lineWords - 1) * WORD_SIZE << " Size: " << dec << lineWords << endl;
+        for(uint32_t i = 0; i < lineWords; i++)
+            cout << utilGet(&counters[order[k] * lineStride], i) << " ";
+        cout << endl;
+    }
+}
+
+//! Append the state of the set to a checkpoint
+/*!
+    Same layout as IdealCache::save, so checkpoints do not depend on the set model.
+    \param buf Checkpoint buffer
+ */
+void AlignedCache::save(string& buf)
+{
+    putVarint(buf, used);
+    for(uint32_t k = 0; k < used; k++)
+    {
+        putVarint(buf, tags[k]);
+        putVarint(buf, lineWords);
+        putVarint(buf, insInsert[order[k]]);
+        for(uint32_t i = 0; i < lineWords; i++)
+            putVarint(buf, utilGet(&counters[order[k] * lineStride], i));
+    }
+    data.save(buf);
+}
+
+//! Restore the state saved by save into an empty set
+/*!
+    \param p Cursor into the checkpoint, advanced past the set
+    \param end One past the last valid byte of the checkpoint
+    \return FALSE if the checkpoint is truncated or does not hold whole lines that fit the set
+ */
+bool AlignedCache::load(const unsigned char*& p, const unsigned char* end)
+{
+    uint64_t n, sA, size, iC, v;
+    if(used != 0 || !getVarint(p, end, n) || n > ways)
+        return false;
+    for(uint64_t b = 0; b < n; b++)
+    {
+        if(!getVarint(p, end, sA) || !getVarint(p, end, size) || !getVarint(p, end, iC))
+            return false;
+        if(size != lineWords || sA != lineAddress(sA))
+            return false;
+        uint32_t way = order[used];
+        tags[used] = sA;
+        insInsert[way] = iC;
+        used++;
+        for(uint32_t i = 0; i < lineWords; i++)
+        {
+            if(!getVarint(p, end, v))
+                return false;
+            utilPut(&counters[way * lineStride], i, v);
+        }
+    }
+    return data.load(p, end);
+}
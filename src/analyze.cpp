@@ -0,0 +1,457 @@
+/*!
+    \file analyze.cpp
+    \brief Statistics of the accessed word runs of the regions of a hint file, replaces asa, cluster and analyser
+
+    The hint file is mapped into memory and its blocks are shared out between worker threads. Every worker decodes its blocks on its own and aggregates the word runs of the records into a hash table of its own, the tables are merged once all workers are done and the regions with the most runs are picked with a heap. The records of the regions with the most evictions can also be dumped as one CSV file per region, and all records printed as text.
+ */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <unordered_map>
+#include <pthread.h>
+#include "evictionrecord.H"
+#include "hintfile.H"
+#include "counters.H"
+
+using namespace std;
+
+string optHintFile, optOutFile, optClusterPrefix = "reg_";
+uint64_t optBinSize = 4096;
+uint32_t optTopCount = 10;
+uint32_t optClusterCount = 0;
+uint32_t optThreads = 0;
+bool optCSV = false;
+bool optPrint = false;
+
+//! Word runs of the records of a bin
+typedef struct binStat
+{
+    //! Number of runs
+    uint64_t count;
+    //! Sum and sum of squares of the run lengths in words
+    uint64_t sumSamples, sumSqSamples;
+    //! Number of eviction records
+    uint64_t records;
+    //! Number of runs per run length
+    Histogram words;
+    binStat(): count(0), sumSamples(0), sumSqSamples(0), records(0) {}
+    //! Count n runs of v words
+    inline void add(uint64_t v, uint64_t n)
+    {
+        count += n;
+        sumSamples += v * n;
+        sumSqSamples += v * v * n;
+        words.add(v, n);
+    }
+    inline void add(const binStat& other)
+    {
+        count += other.count;
+        sumSamples += other.sumSamples;
+        sumSqSamples += other.sumSqSamples;
+        records += other.records;
+        words.add(other.words);
+    }
+} binStat;
+
+typedef unordered_map<uint64_t, binStat> binMap;
+
+//! Blocks of the hint file handled by a worker thread
+typedef struct analyzeWorker
+{
+    pthread_t thread;
+    const HintMap* hints;
+    //! The worker takes the blocks first, first + step, ...
+    uint32_t first, step;
+    //! log2 of the bin size
+    uint32_t binShift;
+    //! Statistics of the blocks of the worker
+    binMap bins;
+    //! Bins dumped by -c, in order of their files
+    const vector<uint64_t>* clusters;
+    //! CSV lines of every cluster per block, filled in by the dump pass
+    vector<vector<string> >* lines;
+    bool corrupt;
+} analyzeWorker;
+
+void usage(char* name)
+{
+    cout << "Usage : " << name
+         << "\n\t-f path/to/HintFile \n\t[-b] BinSize in Bytes, default 4096 \n\t[-t] TopCount, default 10 \n\t[-x] CSV output"
+         << "\n\t[-o] path/to/Output, default stdout \n\t[-j] Threads, default one per processor"
+         << "\n\t[-c] Clusters, dump the records of the bins with the most evictions \n\t[-C] ClusterPrefix, the clusters go to ClusterPrefix<i>.csv, default reg_"
+         << "\n\t[-p] print every record"
+         << endl;
+    exit(0);
+}
+
+void setArgs(int argc, char* argv[])
+{
+    short c;
+    while( (c = getopt(argc, argv, "f:b:t:xo:j:c:C:ph?")) != -1)
+    {
+        switch(c)
+        {
+          case 'f':
+            optHintFile = optarg;
+            break;
+          case 'b':
+            optBinSize = strtoull(optarg, NULL, 0);
+            break;
+          case 't':
+            optTopCount = atoi(optarg);
+            break;
+          case 'x':
+            optCSV = true;
+            break;
+          case 'o':
+            optOutFile = optarg;
+            break;
+          case 'j':
+            optThreads = atoi(optarg);
+            break;
+          case 'c':
+            optClusterCount = atoi(optarg);
+            break;
+          case 'C':
+            optClusterPrefix = optarg;
+            break;
+          case 'p':
+            optPrint = true;
+            break;
+          case 'h':
+          case '?':
+          default:
+            usage(argv[0]);
+        }
+    }
+    if(optHintFile.empty())
+        usage(argv[0]);
+    if(optBinSize < WORD_SIZE || (optBinSize & (optBinSize - 1)) != 0)
+    {
+        cerr << "The bin size must be a power of two of at least " << WORD_SIZE << " Bytes" << endl;
+        exit(1);
+    }
+    if(optThreads == 0)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        optThreads = n > 0 ? n : 1;
+    }
+}
+
+//! Aggregate the word runs of the blocks of a worker
+void* aggregate(void* arg)
+{
+    analyzeWorker* w = (analyzeWorker*)arg;
+    uint32_t lengths[EVICT_RUN_MAX_COUNT];
+    vector<EvictionRecord> records;
+    vector<hintRegion> regions;
+    uint32_t shift = __builtin_ctzll(w->hints->getRegionSize());
+    for(uint32_t b = w->first; b < w->hints->blockCount(); b += w->step)
+    {
+        if(w->hints->isHistogram())
+        {
+            if(!w->hints->decodeRegions(b, regions))
+            {
+                w->corrupt = true;
+                break;
+            }
+            // The regions of the file are at least as large as the bins, checked by main
+            for(vector<hintRegion>::iterator it = regions.begin(); it != regions.end(); it++)
+            {
+                binStat& s = w->bins[(it->region << shift) >> w->binShift];
+                for(uint32_t v = 1; v < it->words.size(); v++)
+                {
+                    if(it->words[v] != 0)
+                        s.add(v, it->words[v]);
+                }
+            }
+            continue;
+        }
+        if(!w->hints->decode(b, records))
+        {
+            w->corrupt = true;
+            break;
+        }
+        for(vector<EvictionRecord>::iterator it = records.begin(); it != records.end(); it++)
+        {
+            binStat& s = w->bins[it->getBlockAddress() >> w->binShift];
+            s.records++;
+            uint32_t n = it->getRuns(lengths);
+            for(uint32_t i = 0; i < n; i++)
+                s.add(lengths[i], 1);
+        }
+    }
+    return NULL;
+}
+
+//! Write the touched words of the records of the dumped bins, one CSV line per record
+void* dump(void* arg)
+{
+    analyzeWorker* w = (analyzeWorker*)arg;
+    vector<EvictionRecord> records;
+    unordered_map<uint64_t, uint32_t> cluster;
+    for(uint32_t i = 0; i < w->clusters->size(); i++)
+        cluster[(*w->clusters)[i]] = i;
+
+    for(uint32_t b = w->first; b < w->hints->blockCount(); b += w->step)
+    {
+        if(!w->hints->decode(b, records))
+        {
+            w->corrupt = true;
+            break;
+        }
+        vector<string>& out = (*w->lines)[b];
+        out.resize(w->clusters->size());
+        for(vector<EvictionRecord>::iterator it = records.begin(); it != records.end(); it++)
+        {
+            unordered_map<uint64_t, uint32_t>::iterator c = cluster.find(it->getBlockAddress() >> w->binShift);
+            if(c == cluster.end())
+                continue;
+            for(int32_t i = 0; i < it->getBlockSize(); i++)
+                out[c->second] += it->getBitmapValue(i) > 0 ? "1," : "0,";
+            out[c->second] += '\n';
+        }
+    }
+    return NULL;
+}
+
+//! Run a pass of the workers over every block of the file
+/*!
+    \param workers Workers, each one has its share of the blocks set
+    \param pass Thread function of the pass
+    \return FALSE if a block could not be decoded
+ */
+bool runWorkers(vector<analyzeWorker>& workers, void* (*pass)(void*))
+{
+    for(uint32_t i = 0; i < workers.size(); i++)
+    {
+        if(pthread_create(&workers[i].thread, NULL, pass, &workers[i]) != 0)
+        {
+            cerr << "Could not start worker " << i << endl;
+            exit(1);
+        }
+    }
+    bool corrupt = false;
+    for(uint32_t i = 0; i < workers.size(); i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        corrupt |= workers[i].corrupt;
+    }
+    return !corrupt;
+}
+
+//! Ranking of the bins, TRUE if bin a ranks after bin b
+/*!
+    Bins with a larger key rank first, the lower bin index on ties so the output does not depend on the threads.
+ */
+typedef struct binRank
+{
+    inline bool operator()(const pair<uint64_t, uint64_t>& a, const pair<uint64_t, uint64_t>& b) const
+    {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    }
+} binRank;
+
+//! Pick the bins with the largest key
+/*!
+    A heap of the best k bins seen so far, its top is the worst of them.
+    \param bins Merged statistics
+    \param k Number of bins to pick
+    \param byRecords TRUE to rank by number of evictions, FALSE by number of runs
+    \return Bin indexes, best first
+ */
+vector<uint64_t> topBins(const binMap& bins, uint32_t k, bool byRecords)
+{
+    priority_queue<pair<uint64_t, uint64_t>, vector<pair<uint64_t, uint64_t> >, binRank> heap;
+    for(binMap::const_iterator it = bins.begin(); it != bins.end() && k > 0; it++)
+    {
+        pair<uint64_t, uint64_t> key(byRecords ? it->second.records : it->second.count, it->first);
+        if(key.first == 0)
+            continue;
+        if(heap.size() < k)
+            heap.push(key);
+        else if(binRank()(key, heap.top()))
+        {
+            heap.pop();
+            heap.push(key);
+        }
+    }
+    vector<uint64_t> top(heap.size());
+    for(uint32_t i = top.size(); i > 0; i--)
+    {
+        top[i - 1] = heap.top().second;
+        heap.pop();
+    }
+    return top;
+}
+
+void printStat(uint64_t index, const binStat& s)
+{
+    double variance = s.count > 1 ? (double(s.sumSqSamples) - double(s.sumSamples) * s.sumSamples / s.count) / (s.count - 1) : 0;
+    double sd = sqrt(variance);
+    double mean = double(s.sumSamples) / s.count;
+    if(optCSV)
+    {
+        cout << index << "," << s.count << "," << variance << "," << sd << "," << mean << ",";
+        for(uint32_t j = 1; j <= EVICT_BITMAP_MAX_SIZE; j++)
+            cout << j << "," << s.words[j] << ",";
+        cout << endl;
+        return;
+    }
+    cout << "-- Bin[" << index << "]" << endl;
+    cout << "Count: " << s.count << endl;
+    cout << "Variance: " << variance << endl;
+    cout << "Standard Deviation: " << sd << endl;
+    cout << "Mean: " << mean << endl;
+    for(uint32_t j = 0; j < s.words.size(); j++)
+    {
+        if(s.words[j] != 0)
+            cout << j << " words accessed " << s.words[j] << " times" << endl;
+    }
+    cout << endl;
+}
+
+//! Print every record of the file, in file order
+bool printRecords(const HintMap& hints)
+{
+    vector<EvictionRecord> records;
+    for(uint32_t b = 0; b < hints.blockCount(); b++)
+    {
+        if(!hints.decode(b, records))
+            return false;
+        for(vector<EvictionRecord>::iterator it = records.begin(); it != records.end(); it++)
+            it->print();
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    setArgs(argc, argv);
+
+    HintMap hints(optHintFile);
+    if(!hints.good())
+    {
+        cerr << "Could not read the hint file " << optHintFile << endl;
+        return 1;
+    }
+    if(hints.isHistogram() && (optPrint || optClusterCount != 0))
+    {
+        cerr << "A histogram hint file has no records to print or cluster" << endl;
+        return 1;
+    }
+    if(hints.isHistogram() && optBinSize < hints.getRegionSize())
+    {
+        cerr << "The bins can not be smaller than the " << hints.getRegionSize() << " Byte regions of a histogram hint file" << endl;
+        return 1;
+    }
+
+    ofstream outFile;
+    streambuf* stdoutBuf = cout.rdbuf();
+    if(!optOutFile.empty())
+    {
+        outFile.open(optOutFile.c_str(), ios::out);
+        if(!outFile)
+        {
+            cerr << "Could not open " << optOutFile << " for writing" << endl;
+            return 1;
+        }
+        // EvictionRecord::print writes to cout
+        cout.rdbuf(outFile.rdbuf());
+    }
+
+    int status = 0;
+    if(optPrint)
+    {
+        if(!printRecords(hints))
+        {
+            cerr << "Corrupt block in " << optHintFile << endl;
+            status = 1;
+        }
+        cout.rdbuf(stdoutBuf);
+        return status;
+    }
+
+    uint32_t threads = optThreads < hints.blockCount() ? optThreads : hints.blockCount();
+    if(threads == 0)
+        threads = 1;
+    vector<analyzeWorker> workers(threads);
+    for(uint32_t i = 0; i < threads; i++)
+    {
+        workers[i].hints = &hints;
+        workers[i].first = i;
+        workers[i].step = threads;
+        workers[i].binShift = __builtin_ctzll(optBinSize);
+        workers[i].clusters = NULL;
+        workers[i].lines = NULL;
+        workers[i].corrupt = false;
+    }
+    if(!runWorkers(workers, aggregate))
+    {
+        cerr << "Corrupt block in " << optHintFile << endl;
+        cout.rdbuf(stdoutBuf);
+        return 1;
+    }
+
+    // Merge into the largest table
+    uint32_t largest = 0;
+    for(uint32_t i = 1; i < threads; i++)
+    {
+        if(workers[i].bins.size() > workers[largest].bins.size())
+            largest = i;
+    }
+    binMap& bins = workers[largest].bins;
+    for(uint32_t i = 0; i < threads; i++)
+    {
+        if(i == largest)
+            continue;
+        for(binMap::iterator it = workers[i].bins.begin(); it != workers[i].bins.end(); it++)
+            bins[it->first].add(it->second);
+        binMap().swap(workers[i].bins);
+    }
+
+    vector<uint64_t> top = topBins(bins, optTopCount, false);
+    for(vector<uint64_t>::iterator it = top.begin(); it != top.end(); it++)
+        printStat(*it, bins[*it]);
+
+    if(optClusterCount != 0)
+    {
+        vector<uint64_t> clusters = topBins(bins, optClusterCount, true);
+        vector<vector<string> > lines(hints.blockCount());
+        for(uint32_t i = 0; i < threads; i++)
+        {
+            workers[i].clusters = &clusters;
+            workers[i].lines = &lines;
+        }
+        if(!runWorkers(workers, dump))
+        {
+            cerr << "Corrupt block in " << optHintFile << endl;
+            status = 1;
+        }
+        for(uint32_t c = 0; c < clusters.size() && status == 0; c++)
+        {
+            stringstream fileName;
+            fileName << optClusterPrefix << c << ".csv";
+            ofstream dumpFile(fileName.str().c_str(), ios::out);
+            for(uint32_t b = 0; b < lines.size(); b++)
+            {
+                if(!lines[b].empty())
+                    dumpFile << lines[b][c];
+            }
+            if(!dumpFile)
+            {
+                cerr << "Could not write " << fileName.str() << endl;
+                status = 1;
+            }
+        }
+    }
+    cout.rdbuf(stdoutBuf);
+    return status;
+}
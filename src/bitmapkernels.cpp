@@ -0,0 +1,271 @@
+/*!
+    \file bitmapkernels.cpp
+    \brief Scalar, SSE2 and AVX2 versions of the word counter kernels for every UTIL_COUNTER_BITS
+*/
+#include <cstring>
+#include "bitmapkernels.H"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BITMAP_KERNELS_X86
+#endif
+
+#if UTIL_COUNTER_BITS == 32
+
+/*
+ * A word i is in the range of an access when (i - lo) < (hi - lo) as
+ * unsigned numbers. The vector versions compare as signed numbers, so both
+ * sides are flipped by the sign bit first.
+ */
+
+static void setScalar(utilWord* c, uint32_t n, uint32_t lo, uint32_t hi)
+{
+    for(uint32_t i = 0; i < n; i++)
+        c[i] = (i - lo) < (hi - lo);
+}
+
+static void addScalar(utilWord* c, uint32_t n, uint32_t lo, uint32_t hi)
+{
+    for(uint32_t i = lo; i < hi; i++)
+        c[i]++;
+}
+
+static uint32_t touchedScalar(const utilWord* c, uint32_t n)
+{
+    uint32_t t = 0;
+    for(uint32_t i = 0; i < n; i++)
+        t += (c[i] != 0);
+    return t;
+}
+
+#ifdef BITMAP_KERNELS_X86
+__attribute__((target("sse2")))
+static inline __m128i rangeMaskSSE(uint32_t i, uint32_t lo, uint32_t hi)
+{
+    __m128i idx = _mm_add_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(int32_t(i - lo)));
+    __m128i sign = _mm_set1_epi32(INT32_MIN);
+    return _mm_cmplt_epi32(_mm_xor_si128(idx, sign), _mm_set1_epi32(int32_t((hi - lo) ^ 0x80000000u)));
+}
+
+__attribute__((target("sse2")))
+static void setSSE(utilWord* c, uint32_t n, uint32_t lo, uint32_t hi)
+{
+    uint32_t i = 0;
+    for(; i + 4 <= n; i += 4)
+        _mm_storeu_si128((__m128i*)(c + i), _mm_srli_epi32(rangeMaskSSE(i, lo, hi), 31));
+    setScalar(c + i, n - i, lo - i, hi - i);
+}
+
+__attribute__((target("sse2")))
+static void addSSE(utilWord* c, uint32_t n, uint32_t lo, uint32_t hi)
+{
+    uint32_t i = lo & ~3u;
+    for(; i + 4 <= n && i < hi; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(c + i));
+        // The mask is -1 in the range
+        _mm_storeu_si128((__m128i*)(c + i), _mm_sub_epi32(v, rangeMaskSSE(i, lo, hi)));
+    }
+    for(; i < hi; i++)
+        c[i] += (i >= lo);
+}
+
+__attribute__((target("sse2")))
+static uint32_t touchedSSE(const utilWord* c, uint32_t n)
+{
+    uint32_t i = 0, t = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        __m128i zero = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(c + i)), _mm_setzero_si128());
+        t += 4 - __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(zero)));
+    }
+    return t + touchedScalar(c + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i rangeMaskAVX2(uint32_t i, uint32_t lo, uint32_t hi)
+{
+    __m256i idx = _mm256_add_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(int32_t(i - lo)));
+    __m256i sign = _mm256_set1_epi32(INT32_MIN);
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(int32_t((hi - lo) ^ 0x80000000u)), _mm256_xor_si256(idx, sign));
+}
+
+__attribute__((target("avx2")))
+static void setAVX2(utilWord* c, uint32_t n, uint32_t lo, uint32_t hi)
+{
+    uint32_t i = 0;
+    for(; i + 8 <= n; i += 8)
+        _mm256_storeu_si256((__m256i*)(c + i), _mm256_srli_epi32(rangeMaskAVX2(i, lo, hi), 31));
+    setSSE(c + i, n - i, lo - i, hi - i);
+}
+
+__attribute__((target("avx2")))
+static void addAVX2(utilWord* c, uint32_t n, uint32_t lo, uint32_t hi)
+{
+    uint32_t i = lo & ~7u;
+    for(; i + 8 <= n && i < hi; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(c + i));
+        _mm256_storeu_si256((__m256i*)(c + i), _mm256_sub_epi32(v, rangeMaskAVX2(i, lo, hi)));
+    }
+    for(; i < hi; i++)
+        c[i] += (i >= lo);
+}
+
+__attribute__((target("avx2")))
+static uint32_t touchedAVX2(const utilWord* c, uint32_t n)
+{
+    uint32_t i = 0, t = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+        __m256i zero = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(c + i)), _mm256_setzero_si256());
+        t += 8 - __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(zero)));
+    }
+    return t + touchedSSE(c + i, n - i);
+}
+#endif
+
+#elif UTIL_COUNTER_BITS == 8
+
+/*
+ * The ranges of an access are short, set and add stay scalar. touched
+ * compares 16 or 32 counters at once.
+ */
+
+static void setScalar(utilWord* c, uint32_t n, uint32_t lo, uint32_t hi)
+{
+    memset(c, 0, n);
+    memset(c + lo, 1, hi - lo);
+}
+
+static void addScalar(utilWord* c, uint32_t n, uint32_t lo, uint32_t hi)
+{
+    for(uint32_t i = lo; i < hi; i++)
+        c[i] += (c[i] != UTIL_COUNTER_MAX);
+}
+
+static uint32_t touchedScalar(const utilWord* c, uint32_t n)
+{
+    uint32_t t = 0;
+    for(uint32_t i = 0; i < n; i++)
+        t += (c[i] != 0);
+    return t;
+}
+
+#ifdef BITMAP_KERNELS_X86
+__attribute__((target("sse2")))
+static uint32_t touchedSSE(const utilWord* c, uint32_t n)
+{
+    uint32_t i = 0, t = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        __m128i zero = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(c + i)), _mm_setzero_si128());
+        t += 16 - __builtin_popcount(_mm_movemask_epi8(zero));
+    }
+    return t + touchedScalar(c + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static uint32_t touchedAVX2(const utilWord* c, uint32_t n)
+{
+    uint32_t i = 0, t = 0;
+    for(; i + 32 <= n; i += 32)
+    {
+        __m256i zero = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(c + i)), _mm256_setzero_si256());
+        t += 32 - __builtin_popcount(uint32_t(_mm256_movemask_epi8(zero)));
+    }
+    return t + touchedSSE(c + i, n - i);
+}
+#endif
+
+#else
+
+/*
+ * One bit per word : the range of an access is a mask per 64 words and a
+ * touched count is a popcount.
+ */
+
+//! Bits of the words lo to hi - 1 in the storage unit w
+static inline uint64_t rangeBits(uint32_t w, uint32_t lo, uint32_t hi)
+{
+    uint32_t first = w << UTIL_COUNTER_SHIFT;
+    if(hi <= first || lo >= first + 64)
+        return 0;
+    uint32_t a = lo > first ? lo - first : 0;
+    uint32_t b = hi < first + 64 ? hi - first : 64;
+    return (~0ULL >> (64 - (b - a))) << a;
+}
+
+static void setScalar(utilWord* c, uint32_t n, uint32_t lo, uint32_t hi)
+{
+    for(uint32_t w = 0; w < utilWords(n); w++)
+        c[w] = rangeBits(w, lo, hi);
+}
+
+static void addScalar(utilWord* c, uint32_t n, uint32_t lo, uint32_t hi)
+{
+    for(uint32_t w = lo >> UTIL_COUNTER_SHIFT; lo < hi && w <= (hi - 1) >> UTIL_COUNTER_SHIFT; w++)
+        c[w] |= rangeBits(w, lo, hi);
+}
+
+//! The bits past the last word are never set
+static uint32_t touchedScalar(const utilWord* c, uint32_t n)
+{
+    uint32_t t = 0;
+    for(uint32_t w = 0; w < utilWords(n); w++)
+        t += __builtin_popcountll(c[w]);
+    return t;
+}
+
+#ifdef BITMAP_KERNELS_X86
+__attribute__((target("popcnt")))
+static uint32_t touchedPopcnt(const utilWord* c, uint32_t n)
+{
+    uint32_t t = 0;
+    for(uint32_t w = 0; w < utilWords(n); w++)
+        t += __builtin_popcountll(c[w]);
+    return t;
+}
+#endif
+
+#endif
+
+//! Pick the widest kernels the CPU supports
+static bitmapKernels selectKernels(void)
+{
+    bitmapKernels k = { setScalar, addScalar, touchedScalar, "scalar" };
+#if defined(BITMAP_KERNELS_X86) && UTIL_COUNTER_BITS == 1
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("popcnt"))
+    {
+        bitmapKernels popcnt = { setScalar, addScalar, touchedPopcnt, "popcnt" };
+        k = popcnt;
+    }
+#elif defined(BITMAP_KERNELS_X86) && UTIL_COUNTER_BITS == 8
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        bitmapKernels avx2 = { setScalar, addScalar, touchedAVX2, "avx2" };
+        k = avx2;
+    }
+    else if(__builtin_cpu_supports("sse2"))
+    {
+        bitmapKernels sse = { setScalar, addScalar, touchedSSE, "sse2" };
+        k = sse;
+    }
+#elif defined(BITMAP_KERNELS_X86)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+    {
+        bitmapKernels avx2 = { setAVX2, addAVX2, touchedAVX2, "avx2" };
+        k = avx2;
+    }
+    else if(__builtin_cpu_supports("sse2"))
+    {
+        bitmapKernels sse = { setSSE, addSSE, touchedSSE, "sse2" };
+        k = sse;
+    }
+#endif
+    return k;
+}
+
+bitmapKernels bitmapOps = selectKernels();
@@ -0,0 +1,74 @@
+/*!
+    \file blockpool.cpp
+    \brief Source code for the BlockPool class
+*/
+#include <new>
+#include <cstring>
+#include "blockpool.H"
+
+BlockPool::BlockPool()
+{
+}
+
+//! Free all slabs, blocks still in use become invalid
+BlockPool::~BlockPool()
+{
+    for(vector<cacheBlock*>::iterator it = blockSlabs.begin(); it != blockSlabs.end(); it++)
+        ::operator delete(*it);
+    for(vector<utilWord*>::iterator it = bitmapSlabs.begin(); it != bitmapSlabs.end(); it++)
+        delete[] *it;
+}
+
+//! Get a zeroed bitmap of at least the given number of storage units
+utilWord* BlockPool::allocateBitmap(uint32_t words)
+{
+    uint32_t c = sizeClass(words);
+    if(c >= freeBitmaps.size())
+        freeBitmaps.resize(c + 1);
+    vector<utilWord*>& free = freeBitmaps[c];
+    if(free.empty())
+    {
+        uint32_t size = 1u << c;
+        uint32_t count = size < BLOCK_POOL_BITMAP_SLAB ? BLOCK_POOL_BITMAP_SLAB / size : 1;
+        utilWord* slab = new utilWord[size * count];
+        bitmapSlabs.push_back(slab);
+        free.reserve(free.size() + count);
+        for(uint32_t i = count; i > 0; i--)
+            free.push_back(slab + (i - 1) * size);
+    }
+    utilWord* bitmap = free.back();
+    free.pop_back();
+    memset(bitmap, 0, words * sizeof(utilWord));
+    return bitmap;
+}
+
+//! Get a cacheBlock from the pool
+/*!
+    The utilizationBitmap of the block is zeroed.
+    \param sA Start Address of the cacheBlock
+    \param eA End Address of the cacheBlock
+    \param iC Instruction Count at time of creation
+    \return Pointer to the cacheBlock, to be given back with release
+ */
+cacheBlock* BlockPool::allocate(uint64_t sA, uint64_t eA, uint64_t iC)
+{
+    if(freeBlocks.empty())
+    {
+        cacheBlock* slab = (cacheBlock*)::operator new(sizeof(cacheBlock) * BLOCK_POOL_SLAB);
+        blockSlabs.push_back(slab);
+        freeBlocks.reserve(freeBlocks.size() + BLOCK_POOL_SLAB);
+        for(uint32_t i = BLOCK_POOL_SLAB; i > 0; i--)
+            freeBlocks.push_back(slab + i - 1);
+    }
+    cacheBlock* block = freeBlocks.back();
+    freeBlocks.pop_back();
+    utilWord* bitmap = allocateBitmap(utilWords((eA - sA) / WORD_SIZE + 1));
+    return new(block) cacheBlock(sA, eA, iC, bitmap);
+}
+
+//! Give a cacheBlock and its bitmap back to the pool
+void BlockPool::release(cacheBlock* block)
+{
+    freeBitmaps[sizeClass(utilWords(block->blockSize))].push_back(block->utilizationBitmap);
+    freeBlocks.push_back(block);
+}
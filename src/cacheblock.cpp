@@ -1,4 +1,6 @@
+#include <cstring>
 #include "cacheblock.H"
+#include "bitmapkernels.H"
 
 //! cacheBlock Constructor
 /*!
@@ -11,9 +13,30 @@ cacheBlock::cacheBlock(uint64_t sA, uint64_t eA, uint64_t iC):
     endAddress(eA),
     insInsert(iC),
     //! Block Size is stored in terms of words
-    blockSize( (eA - sA)/ WORD_SIZE + 1)
+    blockSize( (eA - sA)/ WORD_SIZE + 1),
+    rank(0)
+{
+    utilizationBitmap = new utilWord[utilWords(blockSize)]();
+    next = NULL;
+    previous = NULL;
+}
+
+//! cacheBlock Constructor with external bitmap storage
+/*!
+    Used by the BlockPool, the bitmap belongs to the pool and the block must be given back to the pool instead of being deleted.
+    \param sA Start Address of the cacheBlock
+    \param eA End Address of the cacheBlock
+    \param iC Instruction Count at time of creation
+    \param bitmap Storage for at least blockSize counters
+ */
+cacheBlock::cacheBlock(uint64_t sA, uint64_t eA, uint64_t iC, utilWord* bitmap):
+    startAddress(sA),
+    endAddress(eA),
+    insInsert(iC),
+    blockSize( (eA - sA)/ WORD_SIZE + 1),
+    rank(0),
+    utilizationBitmap(bitmap)
 {
-    utilizationBitmap = new uint32_t[blockSize];
     next = NULL;
     previous = NULL;
 }
@@ -28,12 +51,12 @@ cacheBlock::cacheBlock(const cacheBlock& cB):
     endAddress(cB.endAddress),
     insInsert(cB.insInsert),
     blockSize(cB.blockSize),
+    rank(cB.rank),
     next(cB.next),
     previous(cB.previous)
 {
-    utilizationBitmap = new uint32_t[blockSize];
-    for(int i = 0; i < blockSize; i++)
-        utilizationBitmap[i] = cB.utilizationBitmap[i];
+    utilizationBitmap = new utilWord[utilWords(blockSize)];
+    memcpy(utilizationBitmap, cB.utilizationBitmap, utilWords(blockSize) * sizeof(utilWord));
 }
 
 //! cacheBlock Destructor
@@ -52,17 +75,9 @@ cacheBlock::~cacheBlock(){
  */
 void cacheBlock::setAccessPattern( uint64_t effectiveAddress, uint32_t memoryAccessSize)
 {
-
-    uint64_t start = ( effectiveAddress >> int(log2(WORD_SIZE)) ) << int(log2(WORD_SIZE));
-    uint64_t end =  (((effectiveAddress + memoryAccessSize - 1) >> int(log2(WORD_SIZE))) << int(log2(WORD_SIZE)));
-    for( int i = 0; i < blockSize ; i++)
-    {
-        uint64_t addr = startAddress + i*WORD_SIZE;
-        if ( addr >= start && addr <= end )
-            utilizationBitmap[i] = 1;
-        else
-            utilizationBitmap[i] = 0;
-    }
+    uint32_t lo, hi;
+    accessWords(startAddress, blockSize, effectiveAddress, memoryAccessSize, lo, hi);
+    bitmapOps.set(utilizationBitmap, blockSize, lo, hi);
 }
 
 //! Update the access pattern in the utilizationBitmap
@@ -73,14 +88,9 @@ void cacheBlock::setAccessPattern( uint64_t effectiveAddress, uint32_t memoryAcc
 */
 void cacheBlock::updateAccessPattern(uint64_t effectiveAddress, uint32_t memoryAccessSize)
 {
-    uint64_t start = ( effectiveAddress >> int(log2(WORD_SIZE)) ) << int(log2(WORD_SIZE));
-    uint64_t end =  (((effectiveAddress + memoryAccessSize - 1) >> int(log2(WORD_SIZE))) << int(log2(WORD_SIZE)));
-    for( int i = 0; i < blockSize ; i++)
-    {
-        uint64_t addr = startAddress + i*WORD_SIZE;
-        if ( addr >= start && addr <= end )
-            utilizationBitmap[i] += 1;
-    }
+    uint32_t lo, hi;
+    accessWords(startAddress, blockSize, effectiveAddress, memoryAccessSize, lo, hi);
+    bitmapOps.add(utilizationBitmap, blockSize, lo, hi);
 }
 
 //! Print out the fields of the cacheBlock
@@ -95,7 +105,7 @@ void cacheBlock::print(void)
     std::cout << "Bitmap: " ;
     for(int i = 0; i < blockSize; i++)
     {
-        std::cout << utilizationBitmap[i] << " " ;
+        std::cout << utilGet(utilizationBitmap, i) << " " ;
     }
 }
 
@@ -4,30 +4,47 @@
 */
 #include <iostream>
 #include "cachecontroller.H"
+#include "encoding.H"
 
-//! Constructor for CacheController in a multilevel memory hierarchy
+//! Constructor for the next lower level of a multilevel memory hierarchy
 /*!
-    \param p Pointer to parent CacheController object
-    \param c Pointer to child CacheController object
+    The new level becomes the parent of c. The warmup of the hierarchy is driven by the first level, the lower levels have no warmup of their own.
+    \param c Pointer to the level above
     \param optSetCount Number of sets
     \param optSetSize Size of the each set in Bytes
     \param optGran Maximum Granularity of the cacheBlock
     \param optAligned TRUE for cache aligned access mode
-    \param oWC Number of instructions to allow for cache warmup
+    \param policy Inclusion policy of the hierarchy
+    \param latency Latency of a lookup in this level
+    \param r Replacement policy of the sets
  */
-CacheController::CacheController(CacheController* p, CacheController* c, uint32_t optSetCount, uint32_t optSetSize, uint32_t optGran, bool optAligned, uint64_t oWC):
-    parent(p),
+CacheController::CacheController(CacheController* c, uint32_t optSetCount, uint32_t optSetSize, uint32_t optGran, bool optAligned, inclusionPolicy policy, uint32_t latency, replacementPolicy r):
+    parent(NULL),
     child(c),
     alignedAccess(optAligned),
     firstInsGate(true),
-    optWarmCount(oWC),
-    setSize(optSetSize / WORD_SIZE),
+    execOnce(false),
+    optWarmCount(0),
+    setSize(optSetSize),
     setCount(optSetCount),
-    maxGran(optGran)
+    maxGran(optGran),
+    inclusion(policy),
+    hitLatency(latency),
+    memoryLatency(MEMORY_ACCESS_LATENCY),
+    moving(false),
+    replacement(r)
 {
     for(int i =0; i < optSetCount; i++)
-        cacheSet.insert(cacheSet.begin(), new IdealCache(optSetSize / WORD_SIZE, optGran, optAligned ? 0 : 1 ));
+        cacheSet.insert(cacheSet.begin(), newSet(optSetSize / WORD_SIZE, optGran, optAligned, optSetCount - 1 - i));
     hub = new DataHub(&cacheSet);
+    hub->replacement = replacementName(replacement);
+    c->parent = this;
+    c->inclusion = policy;
+    // The evictions of the sets of both levels come back to their CacheController
+    for(vector<CacheSet*>::iterator it = cacheSet.begin(); it != cacheSet.end(); it++)
+        (*it)->data.victims = this;
+    for(vector<CacheSet*>::iterator it = c->cacheSet.begin(); it != c->cacheSet.end(); it++)
+        (*it)->data.victims = c;
 }
 
 //! Constructor for CacheController - Single level
@@ -37,36 +54,78 @@ CacheController::CacheController(CacheController* p, CacheController* c, uint32_
     \param optGran Maximum Granularity of the cacheBlock
     \param optAligned TRUE for cache aligned access mode
     \param oWC Number of instructions to allow for cache warmup
+    \param r Replacement policy of the sets
  */
-CacheController::CacheController(uint32_t optSetCount, uint32_t optSetSize, uint32_t optGran, bool optAligned, uint64_t oWC):
+CacheController::CacheController(uint32_t optSetCount, uint32_t optSetSize, uint32_t optGran, bool optAligned, uint64_t oWC, replacementPolicy r):
     parent(NULL),
     child(NULL),
     alignedAccess(optAligned),
     firstInsGate(true),
+    execOnce(true),
     optWarmCount(oWC),
     setSize(optSetSize),
     setCount(optSetCount),
-    maxGran(optGran)
+    maxGran(optGran),
+    inclusion(INCLUSION_NONINCLUSIVE),
+    hitLatency(LEVEL_ACCESS_LATENCY),
+    memoryLatency(MEMORY_ACCESS_LATENCY),
+    moving(false),
+    replacement(r)
 {
     for(int i =0; i < optSetCount; i++)
-        cacheSet.insert(cacheSet.begin(), new IdealCache(optSetSize / WORD_SIZE, optGran, optAligned ? 0 : 1));
+        cacheSet.insert(cacheSet.begin(), newSet(optSetSize / WORD_SIZE, optGran, optAligned, optSetCount - 1 - i));
     hub = new DataHub(&cacheSet);
+    hub->replacement = replacementName(replacement);
+}
+
+//! Create a set
+/*!
+    Cache aligned access mode only ever loads whole aligned lines, so a LRU cache gets the fixed geometry AlignedCache. The IdealCache handles blocks of any size and every replacement policy, for aligned lines it behaves like the AlignedCache.
+    \param setSize Size of the set in words
+    \param gran Maximum Granularity of the cacheBlock
+    \param aligned TRUE for cache aligned access mode
+    \param index Index of the set, picks the DRRIP leader sets and seeds the random policy
+    \return The new set
+ */
+CacheSet* CacheController::newSet(uint32_t setSize, uint32_t gran, bool aligned, uint32_t index)
+{
+    switch(replacement)
+    {
+      case REPLACEMENT_SRRIP:
+        return new IdealCache<SRRIPPolicy>(setSize, gran, 1);
+      case REPLACEMENT_BRRIP:
+        return new IdealCache<BRRIPPolicy>(setSize, gran, 1);
+      case REPLACEMENT_DRRIP:
+        return new IdealCache<DRRIPPolicy>(setSize, gran, 1, DRRIPPolicy(&duel, index));
+      case REPLACEMENT_LFU:
+        return new IdealCache<LFUPolicy>(setSize, gran, 1);
+      case REPLACEMENT_RANDOM:
+        return new IdealCache<RandomPolicy>(setSize, gran, 1, RandomPolicy(index));
+      case REPLACEMENT_OPT:
+        return new IdealCache<OPTPolicy>(setSize, gran, 1, OPTPolicy(&nextUse));
+      default:
+        break;
+    }
+    if(aligned)
+        return new AlignedCache(setSize, gran);
+    return new IdealCache<LRUPolicy>(setSize, gran, 1);
 }
 
 //! CacheController destructor
 /*!
-    Iterate over each IdealCache object and deallocate
+    Iterate over each set and deallocate, then the levels below
  */
 CacheController::~CacheController()
 {
-    for(vector<IdealCache*>::iterator it = cacheSet.begin(); it != cacheSet.end(); it++)
+    for(vector<CacheSet*>::iterator it = cacheSet.begin(); it != cacheSet.end(); it++)
         delete *it;
     delete hub;
+    delete parent;
 }
 
 //! Request for a Cache Access
 /*!
-    The access method probes the sets for the memblock requested by the Predictor. The actual access is represented by the effectiveAddress and the memoryAccessSize. The actual access is necessarily contained within the memblock requested by the Predictor. The latency is reported with respect to the result of the probe : hit / collated hit / complete miss / partial miss.
+    The access method probes the sets for the memblock requested by the Predictor. The actual access is represented by the effectiveAddress and the memoryAccessSize. The actual access is necessarily contained within the memblock requested by the Predictor. The latency is reported with respect to the result of the probe : hit / collated hit / complete miss / partial miss. In a multilevel hierarchy it is the sum of the latencies of the levels looked up, see forward.
     \param mb Block of memory requested by the Predictor
     \param effectiveAddress The word aligned start address of the current access
     \param memoryAccessSize The size of the current access in terms of Bytes
@@ -88,38 +147,144 @@ uint32_t CacheController::access(memblock mb , uint64_t effectiveAddress, uint32
     {
         //! Inside a spanning memblock, the access itself may or may not be spanning - but we dont care
 
-        int sIndex = getIndex(mb.startAddress);
-        int cIndex = - 1;
-        uint64_t nStartAddr = mb.startAddress;
-        for( ; nStartAddr <= mb.endAddress; nStartAddr += WORD_SIZE)
-        {
-            cIndex = getIndex(nStartAddr);
-            if(cIndex != sIndex) break;
-        }
-
-        IdealCache* setA = getCacheSet(mb.startAddress);
-        IdealCache* setB = getCacheSet(nStartAddr);
+        uint64_t nStartAddr = getSplitAddress(mb);
         memblock blockA(memblock(mb.startAddress, nStartAddr - WORD_SIZE, mb.insCount, mb.modCount ));
         memblock blockB(memblock(nStartAddr, mb.endAddress, mb.insCount, mb.modCount ));
 
-        latency = setA->access(blockA, effectiveAddress, memoryAccessSize) + setB->access(blockB, effectiveAddress, memoryAccessSize);
-        while ( setA->getWordsInCache() > setA->getCacheSize() ) setA->evict( setA->getVictim(), mb.insCount);
-        while ( setB->getWordsInCache() > setB->getCacheSize() ) setB->evict( setB->getVictim(), mb.insCount);
+        latency = accessSet(getIndex(blockA.startAddress), blockA, effectiveAddress, memoryAccessSize) + accessSet(getIndex(blockB.startAddress), blockB, effectiveAddress, memoryAccessSize);
     }
     else
     {
-        IdealCache* set = getCacheSet(mb.startAddress);
-        latency = set->access(mb, effectiveAddress, memoryAccessSize);
-        while ( set->getWordsInCache() > set->getCacheSize() ) set->evict( set->getVictim(), mb.insCount);
+        latency = accessSet(getIndex(mb.startAddress), mb, effectiveAddress, memoryAccessSize);
     }
 
     if(hub->firstIns + optWarmCount < mb.insCount && execOnce)
+        endWarmup();
+
+    return latency;
+}
+
+//! End the warmup now : reset the statistics of every level of the hierarchy
+/*!
+    Called by access once optWarmCount instructions have passed, or by a caller that disabled the warmup count with execOnce to end the warmup at an instruction of its choice.
+ */
+void CacheController::endWarmup(void)
+{
+    for(CacheController* level = this; level != NULL; level = level->parent)
+        level->hub->reset();
+    execOnce = false;
+}
+
+//! Access a single set and evict until the set fits again
+/*!
+    The memblock must map entirely to the given set. In a single level cache, accesses to different sets are independent, so they can be issued from different threads. In a multilevel hierarchy a miss is forwarded to the level below before the victims are evicted.
+    \param index Index of the set
+    \param mb Block of memory requested by the Predictor
+    \param effectiveAddress The word aligned start address of the current access
+    \param memoryAccessSize The size of the current access in terms of Bytes
+    \return Latency of the operation
+ */
+uint32_t CacheController::accessSet(int index, memblock mb, uint64_t effectiveAddress, uint32_t memoryAccessSize)
+{
+    CacheSet* set = cacheSet[index];
+    if(inclusion == INCLUSION_EXCLUSIVE && child != NULL)
+        return probeSet(set, mb, effectiveAddress, memoryAccessSize);
+    uint32_t latency = set->access(mb, effectiveAddress, memoryAccessSize);
+    if(isLevel())
+        latency = forward(set, latency == SET_MISS_ACCESS_LATENCY, mb, effectiveAddress, memoryAccessSize);
+    set->evictToFit(mb.insCount);
+    return latency;
+}
+
+//! Forward a miss to the level below and count the latency
+/*!
+    \param set Set of this level the memblock maps to
+    \param miss TRUE if the memblock missed in the set
+    \param mb Block of memory requested by the level above
+    \param effectiveAddress The word aligned start address of the current access
+    \param memoryAccessSize The size of the current access in terms of Bytes
+    \return Latency of the lookup in this level, plus the latency of the levels below or of the memory on a miss
+ */
+uint32_t CacheController::forward(CacheSet* set, bool miss, memblock mb, uint64_t effectiveAddress, uint32_t memoryAccessSize)
+{
+    uint32_t latency = hitLatency;
+    if(miss)
+        latency += (parent != NULL) ? parent->access(mb, effectiveAddress, memoryAccessSize) : memoryLatency;
+    set->data.count[COUNTER_LATENCY] += latency;
+    return latency;
+}
+
+//! Look up a miss of the level above in an exclusive level
+/*!
+    An exclusive level only holds the victims of the level above and never loads a miss. On a hit the block moves up : it is counted as a hit, then evicted without being handed down. A miss goes on to the level below, words of the memblock present in the set move up as well.
+    \param set Set of this level the memblock maps to
+    \param mb Block of memory requested by the level above
+    \param effectiveAddress The word aligned start address of the current access
+    \param memoryAccessSize The size of the current access in terms of Bytes
+    \return Latency of the operation
+ */
+uint32_t CacheController::probeSet(CacheSet* set, memblock mb, uint64_t effectiveAddress, uint32_t memoryAccessSize)
+{
+    bool miss = !set->isFullHit(mb.startAddress, mb.size);
+    if(miss)
     {
-        hub->reset();
-        execOnce = false;
+        set->data.access();
+        set->data.miss(NULL, mb.size / WORD_SIZE);
     }
+    else
+        set->access(mb, effectiveAddress, memoryAccessSize);
+    moving = true;
+    set->invalidate(mb.startAddress, mb.endAddress, mb.insCount);
+    moving = false;
+    return forward(set, miss, mb, effectiveAddress, memoryAccessSize);
+}
 
-    return latency;
+//! Write a victim of the level above into an exclusive level
+/*!
+    The victim is loaded like a miss but is not counted as an access, its words start out unused.
+    \param mb The evicted block of the level above
+ */
+void CacheController::fill(memblock mb)
+{
+    if(isSetSpanningBlock(mb))
+    {
+        uint64_t nStartAddr = getSplitAddress(mb);
+        fillSet(getIndex(mb.startAddress), memblock(mb.startAddress, nStartAddr - WORD_SIZE, mb.insCount, mb.modCount));
+        fillSet(getIndex(nStartAddr), memblock(nStartAddr, mb.endAddress, mb.insCount, mb.modCount));
+    }
+    else
+        fillSet(getIndex(mb.startAddress), mb);
+}
+
+//! Write a victim into a single set and evict until the set fits again
+/*!
+    \param index Index of the set
+    \param mb Part of the victim that maps to the set
+ */
+void CacheController::fillSet(int index, memblock mb)
+{
+    CacheSet* set = cacheSet[index];
+    set->data.filling = true;
+    set->access(mb, mb.startAddress, 0);
+    set->data.filling = false;
+    set->evictToFit(mb.insCount);
+}
+
+//! Find where a set spanning memblock has to be split
+/*!
+    \param mb memblock spanning two sets
+    \return Address of the first word that maps to a different set than the start address
+    \sa isSetSpanningBlock
+ */
+uint64_t CacheController::getSplitAddress(memblock mb)
+{
+    int sIndex = getIndex(mb.startAddress);
+    uint64_t nStartAddr = mb.startAddress;
+    for( ; nStartAddr <= mb.endAddress; nStartAddr += WORD_SIZE)
+    {
+        if(getIndex(nStartAddr) != sIndex) break;
+    }
+    return nStartAddr;
 }
 
 //! Check if a memblock spans across a set boundary
@@ -138,52 +303,72 @@ bool CacheController::isSetSpanningBlock(memblock mb)
     return ( sIndex !=  eIndex );
 }
 
-//! Get index of IdealCache object, i.e set, to probe
+//! Get the set to probe
 /*!
     The lower bits for addressing the block inside the set are removed. The result is ANDed with setCount - 1
     \param addr The word aligned start address of a access / memblock
-    \return Pointer to IdealCache object which the given address maps to
+    \return Pointer to the set which the given address maps to
  */
-IdealCache* CacheController::getCacheSet(uint64_t addr)
+CacheSet* CacheController::getCacheSet(uint64_t addr)
 {
     int index = getIndex(addr);
     return cacheSet[index];
 }
 
-//! Eviction triggered by lower level cache
+//! Propagate the eviction of a block of one of the sets
 /*!
-    \param evictBlock cacheBlock to be evicted
+    The DataLogger of the sets hands every eviction to its CacheController, except the ones at the end of the run.
+    - Inclusive : the block is taken back from the levels above.
+    - Exclusive : the block is written into the level below, unless it is moving up.
+    \param er Record of the evicted block
  */
-void CacheController::evict(cacheBlock *evictBlock)
+void CacheController::add(const EvictionRecord& er)
 {
-    // Lower level eviction code here
-    setPattern();
+    uint64_t startAddress = er.getBlockAddress();
+    uint64_t endAddress = startAddress + (er.getBlockSize() - 1) * WORD_SIZE;
+    if(inclusion == INCLUSION_INCLUSIVE && child != NULL)
+        child->evictRegion(startAddress, endAddress);
+    else if(inclusion == INCLUSION_EXCLUSIVE && parent != NULL && !moving)
+        parent->fill(memblock(startAddress, endAddress, er.getInsEvict(), 0));
 }
 
 //! Eviction for an entire region triggered by lower level
 /*!
+    Evicts every block overlapping the region, the evictions propagate further up through add.
     \param startAddress Start Address of the region
     \param endAddress End Address of the region
     \return TRUE if 1 or more blocks were evicted, FALSE otherwise
  */
 bool CacheController::evictRegion(uint64_t startAddress , uint64_t endAddress)
 {
-    // Find the blocks in this region that need to be evicted and call evict on each
-    return false;
+    uint32_t evicted = 0;
+    for(uint64_t addr = (rShiftMaxGran(startAddress) << int(log2(maxGran))); addr <= endAddress; addr += maxGran)
+        evicted += getCacheSet(addr)->invalidate(startAddress, endAddress, hub->lastIns);
+    return evicted != 0;
 }
 
-
-//! SetPattern triggered by higher level cache
-void CacheController::setPattern(void)
+//! Display the statistics of the levels below
+/*!
+    The levels below only see the misses of the level above, their rates are given over the instructions seen by this level.
+    \param optCSV TRUE = CSV FALSE = VERBOSE
+ */
+void CacheController::levelStats(bool optCSV)
 {
-    // Update pattern from child cache
+    int i = 2;
+    for(CacheController* level = parent; level != NULL; level = level->parent, i++)
+    {
+        cout << "----------- Level " << i << endl;
+        level->hub->firstIns = hub->firstIns;
+        level->hub->lastIns = hub->lastIns;
+        level->hub->stats(optCSV);
+    }
 }
 
-//! Iterate over and print contents of each IdealCache object, i.e set
+//! Iterate over and print contents of each set
 void CacheController::print(void)
 {
     int i = 0;
-    for(vector<IdealCache*>::iterator it = cacheSet.begin(); it != cacheSet.end(); it++, i++)
+    for(vector<CacheSet*>::iterator it = cacheSet.begin(); it != cacheSet.end(); it++, i++)
     {
         cout << "----------- Cache Set " << i << endl;
         (*it)->print();
@@ -193,11 +378,61 @@ void CacheController::print(void)
 
 //! Calls purge on each set
 /*!
-    Calls the purge method of each IdealCache object after the end of the simulation run in order to collect the statistics of the blocks presently residing in the cache.
+    Calls the purge method of each set after the end of the simulation run in order to collect the statistics of the blocks presently residing in the cache, then purges the levels below.
     \param insCount Latest instruction count seen by the cache
  */
 void CacheController::purge(uint64_t insCount)
 {
-    for(vector<IdealCache*>::iterator it = cacheSet.begin(); it != cacheSet.end(); it++)
+    for(vector<CacheSet*>::iterator it = cacheSet.begin(); it != cacheSet.end(); it++)
         (*it)->purge(insCount);
+    if(parent != NULL)
+        parent->purge(insCount);
+}
+
+//! Append the state of the cache to a checkpoint
+/*!
+    Saves the geometry of the cache, the warmup state and every set.
+    \param buf Checkpoint buffer
+ */
+void CacheController::save(string& buf)
+{
+    putVarint(buf, setCount);
+    putVarint(buf, setSize);
+    putVarint(buf, maxGran);
+    buf.push_back(alignedAccess ? 1 : 0);
+    buf.push_back(firstInsGate ? 1 : 0);
+    buf.push_back(execOnce ? 1 : 0);
+    putVarint(buf, hub->firstIns);
+    putVarint(buf, hub->lastIns);
+    for(vector<CacheSet*>::iterator it = cacheSet.begin(); it != cacheSet.end(); it++)
+        (*it)->save(buf);
+}
+
+//! Restore the state saved by save into a new cache of the same geometry
+/*!
+    \param p Cursor into the checkpoint, advanced past the cache
+    \param end One past the last valid byte of the checkpoint
+    \return FALSE if the checkpoint is truncated or was saved from a cache of a different geometry
+ */
+bool CacheController::load(const unsigned char*& p, const unsigned char* end)
+{
+    uint64_t sC, sS, mG;
+    if(!getVarint(p, end, sC) || !getVarint(p, end, sS) || !getVarint(p, end, mG) || end - p < 3)
+        return false;
+    bool aligned = (*p++ != 0);
+    if(sC != setCount || sS != setSize || mG != maxGran || aligned != alignedAccess)
+    {
+        cerr << "Checkpoint was saved with -s " << sC << " -c " << sS << " -g " << mG << (aligned ? " -a" : "") << endl;
+        return false;
+    }
+    firstInsGate = (*p++ != 0);
+    execOnce = (*p++ != 0);
+    if(!getVarint(p, end, hub->firstIns) || !getVarint(p, end, hub->lastIns))
+        return false;
+    for(vector<CacheSet*>::iterator it = cacheSet.begin(); it != cacheSet.end(); it++)
+    {
+        if(!(*it)->load(p, end))
+            return false;
+    }
+    return true;
 }
@@ -0,0 +1,92 @@
+/*!
+    \file checkpoint.cpp
+    \brief Source code for the checkpoint file format
+
+    A checkpoint file starts with a 20 byte header : the magic string CUSIMCKP, the format version
+    and the size of the uncompressed payload, both little endian. The zlib compressed payload follows.
+
+    The payload holds the trace position (first instruction, instruction count of the last record simulated,
+    records at that instruction count already simulated), the state of the CacheController with every set,
+    its LRU Queue and DataLogger, and the region bins of the Predictor. All integers are LEB128 varints.
+*/
+#include <fstream>
+#include <zlib.h>
+#include "checkpoint.H"
+#include "encoding.H"
+
+//! Write the state of a run to a checkpoint file
+/*!
+    \param fileName Path of the checkpoint to create
+    \param cc Cache to save
+    \param hint Predictor to save
+    \param pos Position in the trace the state belongs to
+    \return FALSE if the file could not be written
+ */
+bool saveCheckpoint(string fileName, CacheController* cc, Predictor* hint, const tracePosition& pos)
+{
+    string payload;
+    putVarint(payload, pos.firstIns);
+    putVarint(payload, pos.insCount);
+    putVarint(payload, pos.skip);
+    cc->save(payload);
+    hint->save(payload);
+
+    uLongf storedSize = compressBound(payload.size());
+    string stored(storedSize, '\0');
+    if(compress2((Bytef*)&stored[0], &storedSize, (const Bytef*)payload.data(), payload.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+        return false;
+    stored.resize(storedSize);
+
+    string header(CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_SIZE);
+    putFixed32(header, CHECKPOINT_VERSION);
+    putFixed64(header, payload.size());
+
+    ofstream outFile(fileName.c_str(), ios::out | ios::binary | ios::trunc);
+    outFile.write(header.data(), header.size());
+    outFile.write(stored.data(), stored.size());
+    return outFile.good();
+}
+
+//! Restore the state of a run from a checkpoint file
+/*!
+    The cache and predictor must be freshly built with the configuration the checkpoint was saved with.
+    \param fileName Path of the checkpoint
+    \param cc Cache to restore
+    \param hint Predictor to restore
+    \param pos Position in the trace to continue from
+    \return FALSE if the checkpoint could not be read or does not match the cache
+ */
+bool loadCheckpoint(string fileName, CacheController* cc, Predictor* hint, tracePosition& pos)
+{
+    ifstream inFile(fileName.c_str(), ios::in | ios::binary);
+    string file((istreambuf_iterator<char>(inFile)), istreambuf_iterator<char>());
+    const unsigned char* header = (const unsigned char*)file.data();
+    if(file.size() < CHECKPOINT_HEADER_SIZE || file.compare(0, CHECKPOINT_MAGIC_SIZE, CHECKPOINT_MAGIC) != 0)
+    {
+        cerr << fileName << " is not a checkpoint" << endl;
+        return false;
+    }
+    if(getFixed32(header + CHECKPOINT_MAGIC_SIZE) != CHECKPOINT_VERSION)
+    {
+        cerr << "Unsupported checkpoint version " << getFixed32(header + CHECKPOINT_MAGIC_SIZE) << endl;
+        return false;
+    }
+
+    uLongf rawSize = getFixed64(header + CHECKPOINT_MAGIC_SIZE + 4);
+    string payload(rawSize, '\0');
+    if(uncompress((Bytef*)&payload[0], &rawSize, header + CHECKPOINT_HEADER_SIZE, file.size() - CHECKPOINT_HEADER_SIZE) != Z_OK || rawSize != payload.size())
+    {
+        cerr << "Corrupt checkpoint " << fileName << endl;
+        return false;
+    }
+
+    const unsigned char* p = (const unsigned char*)payload.data();
+    const unsigned char* end = p + payload.size();
+    if(!getVarint(p, end, pos.firstIns) || !getVarint(p, end, pos.insCount) || !getVarint(p, end, pos.skip)
+       || !cc->load(p, end) || !hint->load(p, end) || p != end)
+    {
+        cerr << "Checkpoint " << fileName << " does not match the simulated cache" << endl;
+        return false;
+    }
+    return true;
+}
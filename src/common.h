@@ -15,6 +15,10 @@
 #define SET_HIT_ACCESS_LATENCY 50
 //! Latency of a miss / partial miss
 #define SET_MISS_ACCESS_LATENCY 200
+//! Latency of a lookup in a level of a multilevel hierarchy, for the levels without their own latency
+#define LEVEL_ACCESS_LATENCY 4
+//! Latency of a miss in the last level of a multilevel hierarchy
+#define MEMORY_ACCESS_LATENCY 200
 //! Eviction Record bitmap size
 #define EVICT_BITMAP_MAX_SIZE 16
 //! Region Size for a Region Based Predictor
@@ -2,49 +2,28 @@
   \file datahub.cpp
   \brief Source code for DataHub class
 */
+#include <cstring>
+#include <cmath>
 #include "datahub.H"
 
 //! DataHub Constructor
 /*!
-    \param p Pointer to vector of IdealCache object pointers, i.e the sets.
- */
-DataHub::DataHub(vector<IdealCache*>* p):
-    pCacheSet(p)
-{
-    // Eviction Counter
-    count["eviction"] = 0;
-    // Hit Counter
-    count["hit"] = 0;
-    // Miss Counter
-    count["miss"] = 0;
-    // Access Counter
-    count["access"] = 0;
-    // Word Utilisation Counter
-    /*
-        Keeps a count of the total number of words accessed at least once in the set accumulated from cacheBlocks by looking at the utlizationBitmap at the time of eviction.
-    */
-    count["wordUtilization"] = 0;
-    // Word Waste Counter
-    /*
-        Keeps a count of the total number of words not accessed at least once in the set accumulated from cacheBlock by looking at the utlizationBitmap at the time of eviction.
-     */
-    count["wordWaste"] = 0;
-    // Life Span Counter for evicted cacheBlock
-    count["lifeSpan"] = 0;
-    // Instructions elapsed since last eviction
-    count["evictionLatency"] = 0;
-}
-
-//! Datahub Destructor
+    \param p Pointer to vector of set pointers.
+ */
+DataHub::DataHub(vector<CacheSet*>* p):
+    pCacheSet(p),
+    hints(NULL),
+    replacement("lru")
+{
+}
 
+//! Datahub Destructor : writes out the hints if dumpHint was not called
+/*!
+    The sets may already be gone, so they are not detached from the HintCollector.
+ */
 DataHub::~DataHub()
 {
-    /*
-    for(  map < uint64_t, EvictionRecord* >::iterator mapIterator = hintMMap.begin(); mapIterator != hintMMap.end(); mapIterator++)
-    {
-        delete mapIterator->second;
-    }
-    */
+    delete hints;
 }
 
 
@@ -52,44 +31,100 @@ DataHub::~DataHub()
 /*!
     Accumulates the counters from each set's DataLogger object
     Merges the accessMap from each set's DataLogger object
-    Merges the hintMap from each set's DataLogger object
  */
 void DataHub::aggregate(void)
 {
-    for(vector<IdealCache*>::iterator vit = pCacheSet->begin(); vit != pCacheSet->end(); vit++)
+    for(vector<CacheSet*>::iterator vit = pCacheSet->begin(); vit != pCacheSet->end(); vit++)
     {
-        for(map<string, uint64_t>::iterator mit = count.begin(); mit != count.end(); mit++)
-        {
-            count[mit->first] += (*vit)->data.count[mit->first];
-        }
-        for(map<int,int>::iterator mit = (*vit)->data.accessMap.begin(); mit != (*vit)->data.accessMap.end(); mit++)
-        {
-            if(accessMap.count(mit->first) > 0)
-                accessMap[mit->first] += mit->second;
-            else
-                accessMap[mit->first] = mit->second;
-        }
-        for(multimap<uint64_t, EvictionRecord*>::iterator mmit = (*vit)->data.hintMMap.begin(); mmit != (*vit)->data.hintMMap.end(); mmit++)
-        {
-            hintMMap.insert(pair<uint64_t, EvictionRecord*>(mmit->first, mmit->second));
-        }
-        for(map<uint32_t,uint64_t>::iterator mit = (*vit)->data.bwMap.begin(); mit != (*vit)->data.bwMap.end(); mit++)
-        {
-            if(bwMap.count(mit->first) > 0)
-                bwMap[mit->first] += mit->second;
-            else
-                bwMap[mit->first] = mit->second;
-        }
+        count.add((*vit)->data.count);
+        accessMap.add((*vit)->data.accessMap);
+        bwMap.add((*vit)->data.bwMap);
+    }
+}
+
+//! Merge the aggregated statistics of another DataHub
+/*!
+    Used to combine the DataHubs of caches that simulated different parts of the same trace. firstIns, lastIns and simCount are left to the caller.
+    \param other DataHub to merge, aggregate must have been called on it
+ */
+void DataHub::merge(DataHub* other)
+{
+    count.add(other->count);
+    accessMap.add(other->accessMap);
+    bwMap.add(other->bwMap);
+}
+
+//! Path of the hint file of a cache
+/*!
+    Only the set count and the cache size tell hint files apart, caches that differ in their line size or replacement policy share the file.
+    \param hintPath Directory of the hint file
+    \param setCount Number of sets
+    \param setSize Size of a set in Bytes
+    \return Path of the hint file
+ */
+string DataHub::hintFileName(string hintPath, uint32_t setCount, uint64_t setSize)
+{
+    stringstream name;
+    name << hintPath << "hint_" << setCount << "_" << ( setSize * setCount ) / 1024 << ".bin";
+    return name.str();
+}
+
+//! Start collecting the hints of the sets
+/*!
+    The eviction records are streamed to the hint file while the simulation runs, dumpHint finishes the file.
+    \param hintPath Directory of the hint file
+    \param regionSize Region size in Bytes to reduce the hints to word count histograms, 0 to keep every eviction record
+ */
+void DataHub::collectHints(string hintPath, uint32_t regionSize)
+{
+    uint32_t sc = pCacheSet->size();
+    uint32_t ss = (*pCacheSet)[0]->getCacheSize() * WORD_SIZE;
+
+    dumpHint();
+    hints = new HintCollector(hintFileName(hintPath, sc, ss), sc, ss, (*pCacheSet)[0]->getMaxGran(), regionSize);
+    if(!hints->good())
+    {
+        cout << "Error dumping hints: Coult not open hintFile" << endl;
+        delete hints;
+        hints = NULL;
+    }
+    attachHints(hints);
+}
+
+//! Make every set hand its eviction records to a HintSink
+/*!
+    \param hc Receiver of the records, owned by the caller, NULL to stop handing them out
+ */
+void DataHub::attachHints(HintSink* hc)
+{
+    for(vector<CacheSet*>::iterator it = pCacheSet->begin(); it != pCacheSet->end(); it++)
+    {
+        (*it)->data.hints = hc;
+    }
+}
+
+//! Make every set keep a copy of the eviction records it hands out, for a checkpoint
+/*!
+    The records written to the hint file before a checkpoint are not written again by a run restored from it, so the checkpoint has to carry them.
+    \param keep TRUE to start keeping the records, FALSE to stop and free the records kept so far
+ */
+void DataHub::keepHints(bool keep)
+{
+    for(vector<CacheSet*>::iterator it = pCacheSet->begin(); it != pCacheSet->end(); it++)
+    {
+        (*it)->data.keepHints = keep;
+        if(!keep)
+            vector<EvictionRecord>().swap((*it)->data.keptHints);
     }
 }
 
 //! Resets all counters to zero
 /*!
-    Only resets all counters to zero. Eviction timer is not reset. This method is called at the end of the cache warmup run. It calls each set's individual reset method. Also hint multimap is not cleared.
+    Only resets all counters and histograms to zero. Eviction timer is not reset. This method is called at the end of the cache warmup run. It calls each set's individual reset method. The hints of the warmup are kept.
  */
 void DataHub::reset(void)
 {
-    for(vector<IdealCache*>::iterator it = pCacheSet->begin(); it != pCacheSet->end(); it++)
+    for(vector<CacheSet*>::iterator it = pCacheSet->begin(); it != pCacheSet->end(); it++)
     {
         (*it)->data.reset();
     }
@@ -106,52 +141,74 @@ void DataHub::stats(bool optCSV)
 
     setSimCount();
     aggregate();
+    print(optCSV);
+}
 
+//! Displays the aggregated statistics
+/*!
+    Displays the counters as they are, aggregate or merge must have been called before.
+    \param optCSV TRUE = CSV FALSE = VERBOSE
+ */
+void DataHub::print(bool optCSV)
+{
     if(optCSV)
     {
-        uint64_t bwSum = 0;
-        for(map<uint32_t, uint64_t>::iterator it = bwMap.begin(); it != bwMap.end(); it++) bwSum += it->first*it->second;
-        cout << count["access"] << ",";
-        cout << count["hit"] << ",";
-        cout << double(count["hit"])/this->simCount * 1000  << ",";
-        cout << count["miss"] << ",";
-        cout << double(count["miss"])/this->simCount * 1000 << ",";
-        cout << count["eviction"] << ",";
-        cout << double(count["evictionLatency"])/count["eviction"] << ",";
-        cout << double(count["lifeSpan"])/count["eviction"] << ",";
-        cout << double(count["wordUtilization"])/(count["wordUtilization"] + count["wordWaste"]) << ",";
+        uint64_t bwSum = bwMap.weightedTotal();
+        cout << count[COUNTER_ACCESS] << ",";
+        cout << count[COUNTER_HIT] << ",";
+        cout << double(count[COUNTER_HIT])/this->simCount * 1000  << ",";
+        cout << count[COUNTER_MISS] << ",";
+        cout << double(count[COUNTER_MISS])/this->simCount * 1000 << ",";
+        cout << count[COUNTER_EVICTION] << ",";
+        cout << double(count[COUNTER_EVICTION_LATENCY])/count[COUNTER_EVICTION] << ",";
+        cout << double(count[COUNTER_LIFESPAN])/count[COUNTER_EVICTION] << ",";
+        cout << double(count[COUNTER_WORD_UTILIZATION])/(count[COUNTER_WORD_UTILIZATION] + count[COUNTER_WORD_WASTE]) << ",";
         cout << bwSum << ",";
 
-        uint64_t acSum = 0;
-        for(map<int,int>::iterator it = accessMap.begin(); it != accessMap.end(); it++) acSum += it->second;
-        for(map<int,int>::iterator it = accessMap.begin(); it != accessMap.end(); it++)
-            cout << it->first << "," << float(it->second)/acSum * 100 << ",";
-        for(map<uint32_t, uint64_t>::iterator it = bwMap.begin(); it != bwMap.end(); it++)
-            cout << it->first << "," << it->second<< ",";
+        uint64_t acSum = accessMap.total();
+        for(uint32_t i = 0; i < accessMap.size(); i++)
+        {
+            if(accessMap[i] != 0)
+                cout << i << "," << float(accessMap[i])/acSum * 100 << ",";
+        }
+        for(uint32_t i = 0; i < bwMap.size(); i++)
+        {
+            if(bwMap[i] != 0)
+                cout << i << "," << bwMap[i] << ",";
+        }
+        sampleStats(optCSV);
     }
     else
     {
 
-        uint64_t bwSum = 0;
-        for(map<uint32_t, uint64_t>::iterator it = bwMap.begin(); it != bwMap.end(); it++) bwSum += it->first*it->second;
+        uint64_t bwSum = bwMap.weightedTotal();
         cout << endl;
-        cout << "Accesses: " << count["access"] << endl;
-        cout << "Hits: " << count["hit"] << endl;
-        cout << "Hits/1kIns: " << double(count["hit"])/this->simCount * 1000  << endl;
-        cout << "Misses: " << count["miss"] << endl;
-        cout << "Misses/1kIns: " << double(count["miss"])/this->simCount * 1000 << endl;
-        cout << "Evictions: " << count["eviction"] << endl;
-        cout << "Average Eviction Latency: " << double(count["evictionLatency"])/count["eviction"] << endl;
-        cout << "Average LifeSpan: " << double(count["lifeSpan"])/count["eviction"] << endl;
-        cout << "Percent Utilization: " << double(count["wordUtilization"])/(count["wordUtilization"] + count["wordWaste"]) << endl;
+        cout << "Replacement Policy: " << replacement << endl;
+        cout << "Accesses: " << count[COUNTER_ACCESS] << endl;
+        cout << "Hits: " << count[COUNTER_HIT] << endl;
+        cout << "Hits/1kIns: " << double(count[COUNTER_HIT])/this->simCount * 1000  << endl;
+        cout << "Misses: " << count[COUNTER_MISS] << endl;
+        cout << "Misses/1kIns: " << double(count[COUNTER_MISS])/this->simCount * 1000 << endl;
+        cout << "Evictions: " << count[COUNTER_EVICTION] << endl;
+        cout << "Average Eviction Latency: " << double(count[COUNTER_EVICTION_LATENCY])/count[COUNTER_EVICTION] << endl;
+        cout << "Average LifeSpan: " << double(count[COUNTER_LIFESPAN])/count[COUNTER_EVICTION] << endl;
+        cout << "Percent Utilization: " << double(count[COUNTER_WORD_UTILIZATION])/(count[COUNTER_WORD_UTILIZATION] + count[COUNTER_WORD_WASTE]) << endl;
         cout << "Miss Bandwidth: " << bwSum << " words" << endl;
+        if(count[COUNTER_LATENCY] != 0)
+            cout << "Average Access Latency: " << double(count[COUNTER_LATENCY])/count[COUNTER_ACCESS] << endl;
 
-        uint64_t acSum = 0;
-        for(map<int,int>::iterator it = accessMap.begin(); it != accessMap.end(); it++) acSum += it->second;
-        for(map<int,int>::iterator it = accessMap.begin(); it != accessMap.end(); it++)
-            cout << it->first << " Word Accessed:  " << float(it->second)/acSum * 100 << " %" << endl;
-        for(map<uint32_t, uint64_t>::iterator it = bwMap.begin(); it != bwMap.end(); it++)
-            cout << it->first << " Word loads occurred " << it->second << " times"<< endl;
+        uint64_t acSum = accessMap.total();
+        for(uint32_t i = 0; i < accessMap.size(); i++)
+        {
+            if(accessMap[i] != 0)
+                cout << i << " Word Accessed:  " << float(accessMap[i])/acSum * 100 << " %" << endl;
+        }
+        for(uint32_t i = 0; i < bwMap.size(); i++)
+        {
+            if(bwMap[i] != 0)
+                cout << i << " Word loads occurred " << bwMap[i] << " times"<< endl;
+        }
+        sampleStats(optCSV);
     }
 }
 
@@ -159,7 +216,7 @@ void DataHub::stats(bool optCSV)
 //! Displays statistics for each set individually
 void DataHub::statsPerSet(bool optCSV)
 {
-    for(vector<IdealCache*>::iterator it = pCacheSet->begin(); it != pCacheSet->end(); it++)
+    for(vector<CacheSet*>::iterator it = pCacheSet->begin(); it != pCacheSet->end(); it++)
     {
         (*it)->data.stats(optCSV);
     }
@@ -173,36 +230,122 @@ void DataHub::statsPerSet(bool optCSV)
 void DataHub::setSimCount(void)
 {
     simCount = lastIns - firstIns;
-    for(vector<IdealCache*>::iterator it = pCacheSet->begin(); it != pCacheSet->end(); it++)
+    for(vector<CacheSet*>::iterator it = pCacheSet->begin(); it != pCacheSet->end(); it++)
     {
         (*it)->data.set(firstIns, lastIns);
     }
 }
 
-//! Dump the hint MultiMap to a binary file
-void DataHub::dumpHint(string hintFileName)
+//! Finish the hint file
+/*!
+    Waits until the records queued by the sets are written and closes the hint file. Does nothing if no hints are collected.
+ */
+void DataHub::dumpHint(void)
 {
-    uint32_t sc = pCacheSet->size();
-    uint32_t ss = (*pCacheSet)[0]->getCacheSize() * WORD_SIZE;
-    stringstream sstrA, sstrB;
-    string setCount, cacheSizeKB;
-    sstrA << sc;
-    sstrA >> setCount;
-    sstrB << ( ss * sc ) / 1024;
-    sstrB >> cacheSizeKB;
+    if(hints == NULL)
+        return;
+    attachHints(NULL);
+    delete hints;
+    hints = NULL;
+}
 
-    hintFileName += "hint_" + setCount + "_" + cacheSizeKB +".bin";
+//! Take a snapshot of the counters of all sets
+/*!
+    Unlike aggregate, the snapshot does not touch the DataHub counters, so it can be taken any number of times during a run.
+    \param snap Filled with the current counter values
+ */
+void DataHub::snapshot(hubSnapshot& snap)
+{
+    memset(&snap, 0, sizeof(snap));
+    for(vector<CacheSet*>::iterator vit = pCacheSet->begin(); vit != pCacheSet->end(); vit++)
+    {
+        DataLogger& data = (*vit)->data;
+        snap.access += data.count[COUNTER_ACCESS];
+        snap.hit += data.count[COUNTER_HIT];
+        snap.miss += data.count[COUNTER_MISS];
+        snap.wordUtilization += data.count[COUNTER_WORD_UTILIZATION];
+        snap.wordWaste += data.count[COUNTER_WORD_WASTE];
+        snap.missBandwidth += data.bwMap.weightedTotal();
+    }
+}
 
-    hintFile.open( hintFileName.c_str(), ios::out | ios::binary );
+//! Record one measured sample of a sampled simulation
+/*!
+    \param start Snapshot at the start of the measured interval
+    \param end Snapshot at the end of the measured interval
+    \param instructions Length of the measured interval in instructions
+ */
+void DataHub::addSample(const hubSnapshot& start, const hubSnapshot& end, uint64_t instructions)
+{
+    uint64_t access = end.access - start.access;
+    uint64_t used = end.wordUtilization - start.wordUtilization;
+    uint64_t evicted = used + end.wordWaste - start.wordWaste;
+
+    if(access > 0)
+        sampleMissRate.push_back(double(end.miss - start.miss) / access);
+    if(evicted > 0)
+        sampleUtilization.push_back(double(used) / evicted);
+    if(instructions > 0)
+        sampleMissBW.push_back(double(end.missBandwidth - start.missBandwidth) / instructions * 1000);
+}
+
+//! Two sided 95% Student t quantiles for 1 to 30 degrees of freedom
+static const double tQuantile95[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                      2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                      2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+
+//! Mean and half width of the 95% confidence interval of a set of samples
+/*!
+    \param v Samples
+    \param mean Sample mean
+    \param ci Half width of the confidence interval, 0 with fewer than two samples
+ */
+static void confidence(const vector<double>& v, double& mean, double& ci)
+{
+    mean = 0;
+    ci = 0;
+    if(v.empty())
+        return;
+    for(vector<double>::const_iterator it = v.begin(); it != v.end(); it++) mean += *it;
+    mean /= v.size();
+    if(v.size() < 2)
+        return;
+
+    double sq = 0;
+    for(vector<double>::const_iterator it = v.begin(); it != v.end(); it++) sq += (*it - mean) * (*it - mean);
+    double sd = sqrt(sq / (v.size() - 1));
+    uint32_t df = v.size() - 1;
+    double t = df <= 30 ? tQuantile95[df - 1] : 1.96;
+    ci = t * sd / sqrt(double(v.size()));
+}
 
-    if (hintFile)
+//! Displays the sample estimates of a sampled simulation
+/*!
+    Nothing is displayed when no samples were recorded.
+    \param optCSV TRUE = CSV FALSE = VERBOSE
+ */
+void DataHub::sampleStats(bool optCSV)
+{
+    if(sampleMissRate.empty())
+        return;
+
+    double mrMean, mrCI, utMean, utCI, bwMean, bwCI;
+    confidence(sampleMissRate, mrMean, mrCI);
+    confidence(sampleUtilization, utMean, utCI);
+    confidence(sampleMissBW, bwMean, bwCI);
+
+    if(optCSV)
     {
-        for( multimap<uint64_t,EvictionRecord*>::iterator it = hintMMap.begin(); it != hintMMap.end(); it++)
-        {
-            hintFile.write((char*)&(*it->second), sizeof(EvictionRecord));
-        }
-        hintFile.close();
+        cout << sampleMissRate.size() << ",";
+        cout << mrMean << "," << mrCI << ",";
+        cout << utMean << "," << utCI << ",";
+        cout << bwMean << "," << bwCI << ",";
     }
     else
-        cout << "Error dumping hints: Coult not open hintFile" << endl;
+    {
+        cout << "Samples: " << sampleMissRate.size() << endl;
+        cout << "Sampled Miss Rate: " << mrMean << " +/- " << mrCI << " (95% CI)" << endl;
+        cout << "Sampled Percent Utilization: " << utMean << " +/- " << utCI << " (95% CI)" << endl;
+        cout << "Sampled Miss Bandwidth/1kIns: " << bwMean << " +/- " << bwCI << " words (95% CI)" << endl;
+    }
 }
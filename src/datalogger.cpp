@@ -2,29 +2,31 @@
     \file datalogger.cpp
     \brief Source code for the DataLogger class
  */
+#include <cstring>
 #include "datalogger.H"
+#include "bitmapkernels.H"
+#include "encoding.H"
 using namespace std;
 
-//! Constructor initialises counter map with zeros
-DataLogger::DataLogger()
+//! Constructor, the counters start at zero
+/*!
+    The histograms get a bucket for every word count of an EvictionRecord up front, they only grow for larger blocks.
+ */
+DataLogger::DataLogger():
+    evictionTimer(0),
+    simCount(0),
+    hints(NULL),
+    victims(NULL),
+    filling(false),
+    keepHints(false),
+    bwMap(EVICT_BITMAP_MAX_SIZE + 1),
+    accessMap(EVICT_BITMAP_MAX_SIZE + 1)
 {
-    count["eviction"] = 0;
-    count["hit"] = 0;
-    count["miss"] = 0;
-    count["access"] = 0;
-    count["wordUtilization"] = 0;
-    count["wordWaste"] = 0;
-    count["lifeSpan"] = 0;
-    count["evictionLatency"] = 0;
 }
 
-//! Destructor : clean up the hint map
+//! Destructor, the HintSink is owned elsewhere
 DataLogger::~DataLogger()
 {
-    // The hintMMap does not need to be cleaned up because at the end
-    // of the simulation run all the pointers are copied into the
-    // hintMMap at the datahub, the we can iterate over all the
-    // datahub objects and call delete on each of them.
 }
 
 //! Function called when a block is evicted from a set
@@ -36,49 +38,43 @@ DataLogger::~DataLogger()
  */
 void DataLogger::evict(cacheBlock* pDeleteBlock, uint64_t insCount, bool isPurge)
 {
-    int wordAccessIndex = 0;
-
-    count["eviction"]++;
-    count["evictionLatency"] += (insCount - evictionTimer);
-    count["lifeSpan"] += (insCount - pDeleteBlock->insInsert);
+    count[COUNTER_EVICTION]++;
+    count[COUNTER_EVICTION_LATENCY] += (insCount - evictionTimer);
+    count[COUNTER_LIFESPAN] += (insCount - pDeleteBlock->insInsert);
 
     /*
      * Update Total Word Utilisation Count and calculate the Number of Words touched in this block
      */
 
 
-    for(int i = 0; i < pDeleteBlock->blockSize; i++ )
-    {
-        if(pDeleteBlock->utilizationBitmap[i] > 0)
-        {
-            count["wordUtilization"]++;
-            wordAccessIndex++;
-        }
-        else
-            count["wordWaste"]++;
-    }
-
+    uint32_t wordAccessIndex = bitmapOps.touched(pDeleteBlock->utilizationBitmap, pDeleteBlock->blockSize);
+    count[COUNTER_WORD_UTILIZATION] += wordAccessIndex;
+    count[COUNTER_WORD_WASTE] += pDeleteBlock->blockSize - wordAccessIndex;
 
-    if(accessMap.count(wordAccessIndex) > 0)
-        accessMap[wordAccessIndex] += 1;
-    else
-        accessMap[wordAccessIndex] = 1;
+    accessMap.add(wordAccessIndex);
 
     if(!isPurge){
         evictionTimer = insCount;
     }
 
     this->insertHint(pDeleteBlock, insCount);
+    if(victims != NULL && !isPurge)
+        victims->add(EvictionRecord(pDeleteBlock, insCount));
 }
 
-//! Inserts a hint into the MultiMap
+//! Hands the record of an eviction to the HintSink
 /*!
     \param pDeleteBlock The block which is being evicted
+    \param insCount The instruction count at the time of eviction
  */
 void DataLogger::insertHint(cacheBlock* pDeleteBlock, uint64_t insCount)
 {
-    EvictionRecord *er = new EvictionRecord(pDeleteBlock, insCount);
-    hintMMap.insert(pair<uint64_t, EvictionRecord*>(pDeleteBlock->startAddress, er));
+    if(hints == NULL)
+        return;
+    EvictionRecord er(pDeleteBlock, insCount);
+    hints->add(er);
+    if(keepHints)
+        keptHints.push_back(er);
 }
 
 //! Displays set statistics
@@ -89,37 +85,41 @@ void DataLogger::stats(bool optCSV)
 {
     if (optCSV)
     {
-        cout << count["access"] << ",";
-        cout << count["hit"] << ",";
-        cout << double(count["hit"])/this->simCount * 1000 << ",";
-        cout << count["miss"] << ",";
-        cout << count["eviction"] << ",";
-
-        cout << double(count["evictionLatency"])/count["eviction"] << ",";
-        cout << double(count["lifeSpan"])/count["eviction"] << ",";
-        cout << double(count["wordUtilization"])/(count["wordUtilization"] + count["wordWaste"]) << ",";
-
-        uint64_t sum = 0;
-        for(map<int,int>::iterator it = accessMap.begin(); it != accessMap.end(); it++) sum += it->second;
-        for(map<int,int>::iterator it = accessMap.begin(); it != accessMap.end(); it++)
-            cout << it->first << "," << float(it->second)/sum * 100 << ",";
+        cout << count[COUNTER_ACCESS] << ",";
+        cout << count[COUNTER_HIT] << ",";
+        cout << double(count[COUNTER_HIT])/this->simCount * 1000 << ",";
+        cout << count[COUNTER_MISS] << ",";
+        cout << count[COUNTER_EVICTION] << ",";
+
+        cout << double(count[COUNTER_EVICTION_LATENCY])/count[COUNTER_EVICTION] << ",";
+        cout << double(count[COUNTER_LIFESPAN])/count[COUNTER_EVICTION] << ",";
+        cout << double(count[COUNTER_WORD_UTILIZATION])/(count[COUNTER_WORD_UTILIZATION] + count[COUNTER_WORD_WASTE]) << ",";
+
+        uint64_t sum = accessMap.total();
+        for(uint32_t i = 0; i < accessMap.size(); i++)
+        {
+            if(accessMap[i] != 0)
+                cout << i << "," << float(accessMap[i])/sum * 100 << ",";
+        }
     }
     else
     {
 
-        cout << "Accesses: " << count["access"] << endl;
-        cout << "Hits: " << count["hit"] << endl;
-        cout << "Hits/1kIns : " << double(count["hit"])/this->simCount * 1000  << endl;
-        cout << "Misses: " << count["miss"] << endl;
-        cout << "Evictions: " << count["eviction"] << endl;
-        cout << "Average Eviction Latency: " << double(count["evictionLatency"])/count["eviction"] << endl;
-        cout << "Average LifeSpan: " << double(count["lifeSpan"])/count["eviction"] << endl;
-        cout << "Percent Utilization: " << double(count["wordUtilization"])/(count["wordUtilization"] + count["wordWaste"]) << endl;
-
-        uint64_t sum = 0;
-        for(map<int,int>::iterator it = accessMap.begin(); it != accessMap.end(); it++) sum += it->second;
-        for(map<int,int>::iterator it = accessMap.begin(); it != accessMap.end(); it++)
-            cout << it->first << " Word Accessed:  " << float(it->second)/sum * 100 << " %" << endl;
+        cout << "Accesses: " << count[COUNTER_ACCESS] << endl;
+        cout << "Hits: " << count[COUNTER_HIT] << endl;
+        cout << "Hits/1kIns : " << double(count[COUNTER_HIT])/this->simCount * 1000  << endl;
+        cout << "Misses: " << count[COUNTER_MISS] << endl;
+        cout << "Evictions: " << count[COUNTER_EVICTION] << endl;
+        cout << "Average Eviction Latency: " << double(count[COUNTER_EVICTION_LATENCY])/count[COUNTER_EVICTION] << endl;
+        cout << "Average LifeSpan: " << double(count[COUNTER_LIFESPAN])/count[COUNTER_EVICTION] << endl;
+        cout << "Percent Utilization: " << double(count[COUNTER_WORD_UTILIZATION])/(count[COUNTER_WORD_UTILIZATION] + count[COUNTER_WORD_WASTE]) << endl;
+
+        uint64_t sum = accessMap.total();
+        for(uint32_t i = 0; i < accessMap.size(); i++)
+        {
+            if(accessMap[i] != 0)
+                cout << i << " Word Accessed:  " << float(accessMap[i])/sum * 100 << " %" << endl;
+        }
     }
 }
 
@@ -131,12 +131,112 @@ void DataLogger::stats(bool optCSV)
 void DataLogger::miss(cacheBlock* pNewBlock, uint32_t bw)
 {
     //! When bw is 0, it means that a same level cleanup occurs where are words are present in the cache and the idealcache performs collation
-    if(bw != 0)
+    if(bw != 0 && !filling)
+    {
+        count[COUNTER_MISS]++;
+        bwMap.add(bw);
+    }
+}
+
+//! Append the state of the DataLogger to a checkpoint
+/*!
+    Saves the eviction timer, the counters, the histograms and the eviction records kept since keepHints was set, so a restored run can hand the hints of the warmup to its own hint file.
+    \param buf Checkpoint buffer
+ */
+void DataLogger::save(string& buf)
+{
+    putVarint(buf, evictionTimer);
+    putVarint(buf, COUNTER_COUNT);
+    for(uint32_t i = 0; i < COUNTER_COUNT; i++)
+    {
+        putString(buf, Counters::name(counterId(i)));
+        putVarint(buf, count[counterId(i)]);
+    }
+    saveHistogram(buf, accessMap);
+    saveHistogram(buf, bwMap);
+    putVarint(buf, keptHints.size());
+    for(vector<EvictionRecord>::iterator it = keptHints.begin(); it != keptHints.end(); it++)
+    {
+        putVarint(buf, it->getBlockAddress());
+        buf.append((const char*)&*it, sizeof(EvictionRecord));
+    }
+}
+
+//! Append a histogram to a checkpoint as a list of non empty buckets
+/*!
+    \param buf Checkpoint buffer
+    \param h Histogram to save
+ */
+void DataLogger::saveHistogram(string& buf, const Histogram& h)
+{
+    putVarint(buf, h.entries());
+    for(uint32_t i = 0; i < h.size(); i++)
+    {
+        if(h[i] != 0)
+        {
+            putVarint(buf, i);
+            putVarint(buf, h[i]);
+        }
+    }
+}
+
+//! Restore a histogram saved by saveHistogram
+/*!
+    \param p Cursor into the checkpoint, advanced past the histogram
+    \param end One past the last valid byte of the checkpoint
+    \param h Histogram to restore, cleared first
+    \return FALSE if the checkpoint is truncated
+ */
+bool DataLogger::loadHistogram(const unsigned char*& p, const unsigned char* end, Histogram& h)
+{
+    uint64_t n, k, v;
+    h.clear();
+    if(!getVarint(p, end, n))
+        return false;
+    for(uint64_t i = 0; i < n; i++)
+    {
+        if(!getVarint(p, end, k) || !getVarint(p, end, v) || k > UINT32_MAX)
+            return false;
+        h.add(k, v);
+    }
+    return true;
+}
+
+//! Restore the state saved by save
+/*!
+    The eviction records kept by the checkpoint are handed to the HintSink.
+    \param p Cursor into the checkpoint, advanced past the DataLogger
+    \param end One past the last valid byte of the checkpoint
+    \return FALSE if the checkpoint is truncated
+ */
+bool DataLogger::load(const unsigned char*& p, const unsigned char* end)
+{
+    uint64_t n, k, v;
+    string name;
+    counterId id;
+    if(!getVarint(p, end, evictionTimer) || !getVarint(p, end, n))
+        return false;
+    for(uint64_t i = 0; i < n; i++)
+    {
+        if(!getString(p, end, name) || !getVarint(p, end, v))
+            return false;
+        // Counters unknown to this version are skipped
+        if(Counters::find(name, id))
+            count[id] = v;
+    }
+    if(!loadHistogram(p, end, accessMap) || !loadHistogram(p, end, bwMap))
+        return false;
+    if(!getVarint(p, end, n))
+        return false;
+    for(uint64_t i = 0; i < n; i++)
     {
-        count["miss"]++;
-        if( bwMap.count(bw) > 0 )
-            bwMap[bw]++;
-        else
-            bwMap[bw] = 1;
+        if(!getVarint(p, end, k) || uint64_t(end - p) < sizeof(EvictionRecord))
+            return false;
+        EvictionRecord er;
+        memcpy((void*)&er, p, sizeof(EvictionRecord));
+        p += sizeof(EvictionRecord);
+        if(hints != NULL)
+            hints->add(er);
     }
+    return true;
 }
@@ -1,3 +1,5 @@
+#include <cstring>
+#include <algorithm>
 #include "evictionrecord.H"
 
 EvictionRecord::EvictionRecord()
@@ -5,34 +7,25 @@ EvictionRecord::EvictionRecord()
 
 }
 
-EvictionRecord::EvictionRecord(const EvictionRecord& er):
-    blockSize(er.getBlockSize()),
-    blockAddress(er.getBlockAddress()),
-    insInsert(er.getInsInsert()),
-    insEvict(er.getInsEvict())
-{
-    for(int i = 0; i < blockSize; i++)
-    {
-        bitmap[i] = er.getBitmapValue(i);
-    }
-}
-
-
-EvictionRecord::EvictionRecord(cacheBlock* pDeleteBlock, uint64_t insCount):
-    blockSize(pDeleteBlock->blockSize),
-    blockAddress(pDeleteBlock->startAddress)
+EvictionRecord::EvictionRecord(cacheBlock* pDeleteBlock, uint64_t insCount)
 {
+    // Unused bitmap entries and padding are zeroed so that dumped hint files do not depend on heap contents
+    memset(this, 0, sizeof(EvictionRecord));
+    blockSize = pDeleteBlock->blockSize;
+    blockAddress = pDeleteBlock->startAddress;
     insInsert = pDeleteBlock->insInsert;
     insEvict = insCount;
-    for(int i = 0; i < blockSize; i++)
-    {
-        bitmap[i] = pDeleteBlock->utilizationBitmap[i];
-    }
+    utilCopy(bitmap, 0, pDeleteBlock->utilizationBitmap, 0, std::min(blockSize, uint32_t(EVICT_BITMAP_MAX_SIZE)));
 }
 
-EvictionRecord::~EvictionRecord()
+//! Record with an empty bitmap, used when decoding hint files
+EvictionRecord::EvictionRecord(uint64_t bA, uint32_t bS, uint64_t iI, uint64_t iE)
 {
-
+    memset(this, 0, sizeof(EvictionRecord));
+    blockAddress = bA;
+    blockSize = bS;
+    insInsert = iI;
+    insEvict = iE;
 }
 
 void EvictionRecord::print(void)
@@ -42,6 +35,31 @@ void EvictionRecord::print(void)
     std::cout << "InsEvict: " << insEvict << std::endl;
     std::cout << "Bitmap: ";
     for(int i=0; i < blockSize; i++)
-        std::cout << bitmap[i] << " ";
+        std::cout << utilGet(bitmap, i) << " ";
     std::cout << std::endl;
 }
+
+//! Split the bitmap into runs of accessed words
+/*!
+    Every run of consecutive words with a non zero counter is the block the hints predict for an access to the run.
+    \param lengths Set to the length in words of every run, room for EVICT_RUN_MAX_COUNT runs
+    \return Number of runs
+ */
+uint32_t EvictionRecord::getRuns(uint32_t* lengths) const
+{
+    uint32_t n = 0, run = 0;
+    uint32_t words = blockSize < EVICT_BITMAP_MAX_SIZE ? blockSize : EVICT_BITMAP_MAX_SIZE;
+    for(uint32_t i = 0; i < words; i++)
+    {
+        if(utilGet(bitmap, i) > 0)
+            run++;
+        else if(run > 0)
+        {
+            lengths[n++] = run;
+            run = 0;
+        }
+    }
+    if(run > 0)
+        lengths[n++] = run;
+    return n;
+}
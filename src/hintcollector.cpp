@@ -0,0 +1,144 @@
+/*!
+    \file hintcollector.cpp
+    \brief Source code for the HintCollector class
+*/
+#include <cmath>
+#include "hintcollector.H"
+
+//! Open the hint file and start the writer thread
+/*!
+    \param fileName Path of the hint file to create
+    \param sC Number of sets of the cache
+    \param sS Size of a set in Bytes
+    \param g Line size in Bytes
+    \param regionSize Region size in Bytes to reduce the records to histograms, 0 to write the records
+ */
+HintCollector::HintCollector(string fileName, uint32_t sC, uint32_t sS, uint32_t g, uint32_t regionSize):
+    writer(fileName, sC, sS, g, regionSize == 0 ? HINT_FLAG_UNSORTED : HINT_FLAG_HISTOGRAM | (uint32_t(log2(regionSize)) << HINT_REGION_SHIFT_POS)),
+    reduce(regionSize != 0),
+    regionShift(regionSize == 0 ? 0 : uint32_t(log2(regionSize))),
+    queue(HINT_QUEUE_RECORDS),
+    head(0),
+    count(0),
+    closing(false),
+    running(false)
+{
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&notEmpty, NULL);
+    pthread_cond_init(&notFull, NULL);
+    if(writer.good())
+        running = (pthread_create(&thread, NULL, drain, this) == 0);
+}
+
+//! Destructor : closes the hint file if close was not called
+HintCollector::~HintCollector()
+{
+    close();
+    pthread_cond_destroy(&notFull);
+    pthread_cond_destroy(&notEmpty);
+    pthread_mutex_destroy(&lock);
+}
+
+//! Queue an eviction record
+/*!
+    Blocks while the queue is full. Records added after close are dropped.
+    \param er Record to queue
+ */
+void HintCollector::add(const EvictionRecord& er)
+{
+    pthread_mutex_lock(&lock);
+    while(count == queue.size() && running)
+        pthread_cond_wait(&notFull, &lock);
+    if(running && !closing)
+    {
+        queue[(head + count) % queue.size()] = er;
+        if(count++ == 0)
+            pthread_cond_signal(&notEmpty);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+//! Writer thread main
+/*!
+    Takes the queued records out in batches and consumes them outside of the lock, until close was called and the queue is empty.
+    \param arg Pointer to the HintCollector
+ */
+void* HintCollector::drain(void* arg)
+{
+    HintCollector* hc = (HintCollector*)arg;
+    vector<EvictionRecord> batch;
+    batch.reserve(HINT_DRAIN_RECORDS);
+
+    pthread_mutex_lock(&hc->lock);
+    for(;;)
+    {
+        while(hc->count == 0 && !hc->closing)
+            pthread_cond_wait(&hc->notEmpty, &hc->lock);
+        if(hc->count == 0)
+            break;
+
+        bool full = (hc->count == hc->queue.size());
+        uint32_t n = hc->count < HINT_DRAIN_RECORDS ? hc->count : HINT_DRAIN_RECORDS;
+        batch.clear();
+        for(uint32_t i = 0; i < n; i++)
+            batch.push_back(hc->queue[(hc->head + i) % hc->queue.size()]);
+        hc->head = (hc->head + n) % hc->queue.size();
+        hc->count -= n;
+        if(full)
+            pthread_cond_broadcast(&hc->notFull);
+
+        pthread_mutex_unlock(&hc->lock);
+        for(vector<EvictionRecord>::iterator it = batch.begin(); it != batch.end(); it++)
+            hc->consume(*it);
+        pthread_mutex_lock(&hc->lock);
+    }
+    pthread_mutex_unlock(&hc->lock);
+    return NULL;
+}
+
+//! Write a record or add it to the histogram of its region
+/*!
+    Records are split into runs of accessed words exactly like the Predictor does when it loads the records.
+    \param er Record taken out of the queue
+ */
+void HintCollector::consume(const EvictionRecord& er)
+{
+    if(!reduce)
+    {
+        writer.write(er);
+        return;
+    }
+    uint32_t runs[EVICT_RUN_MAX_COUNT];
+    uint32_t n = er.getRuns(runs);
+    if(n == 0)
+        return;
+    Histogram& words = regions[er.getBlockAddress() >> regionShift];
+    for(uint32_t i = 0; i < n; i++)
+        words.add(runs[i]);
+}
+
+//! Write out the queued records and close the hint file
+/*!
+    Waits for the writer thread to empty the queue. When reducing, the region histograms are written in ascending order of the regions.
+ */
+void HintCollector::close(void)
+{
+    if(!running)
+        return;
+    pthread_mutex_lock(&lock);
+    closing = true;
+    pthread_cond_signal(&notEmpty);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+
+    pthread_mutex_lock(&lock);
+    running = false;
+    // Callers blocked on a full queue give up
+    pthread_cond_broadcast(&notFull);
+    pthread_mutex_unlock(&lock);
+
+    for(map<uint64_t, Histogram>::iterator it = regions.begin(); it != regions.end(); it++)
+        writer.write(it->first, it->second);
+    regions.clear();
+    writer.close();
+}
@@ -0,0 +1,627 @@
+/*!
+    \file hintfile.cpp
+    \brief Source code for the HintWriter, the HintReader and the HintMap
+
+    Hint file layout, all fixed width fields are little endian:
+    - File header (HINT_HEADER_SIZE bytes): magic "CUSIMHNT", uint32 version, uint32 set count, uint32 set size in Bytes, uint32 line size in Bytes, uint32 records per block, uint32 flags, uint64 record count, uint64 file offset of the block index
+    - zlib compressed blocks, each with a header of uint32 record count, uint32 stored payload size, uint32 raw payload size
+    - The block index, magic "CUSIMHIX", uint64 block count, then per block uint64 offset, uint64 smallest address, uint64 largest address, uint32 record count
+    Eviction records inside a raw payload are varints: zigzag block address delta, block size in words, zigzag insertion instruction delta, instructions between insertion and eviction, a mask of the words with a non zero counter, then the counter - 1 of every word in the mask. Files flagged HINT_FLAG_TOUCHED end the record after the mask, every word in the mask has a count of 1.
+    Files flagged HINT_FLAG_HISTOGRAM hold one record per region instead, varints: zigzag region index delta, number of non empty buckets, then the value and count of every bucket. The index holds the start addresses of the regions.
+    Deltas are relative to the previous record of the same block so that every block can be decoded on its own.
+    Files without the magic string are raw EvictionRecord dumps of older versions.
+ */
+#include <cstring>
+#include <zlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "hintfile.H"
+#include "encoding.H"
+
+//! Size of a block index entry in bytes
+#define HINT_INDEX_ENTRY_SIZE 28
+
+//! Create a hint file and write the header
+/*!
+    \param fileName Path of the hint file to create
+    \param sC Number of sets of the cache
+    \param sS Size of a set in Bytes
+    \param g Line size in Bytes
+    \param flags HINT_FLAG_* flags and, for a histogram file, log2 of the region size at HINT_REGION_SHIFT_POS. HINT_FLAG_TOUCHED is added by builds with 1 bit counters.
+    \param bR Number of records per block
+ */
+HintWriter::HintWriter(string fileName, uint32_t sC, uint32_t sS, uint32_t g, uint32_t flags, uint32_t bR):
+    blockRecords(bR),
+    recordCount(0),
+    prevAddress(0),
+    prevInsert(0),
+    regionShift((flags >> HINT_REGION_SHIFT_POS) & 0xff),
+    touchedOnly(UTIL_COUNTER_BITS == 1 && !(flags & HINT_FLAG_HISTOGRAM))
+{
+    if(touchedOnly)
+        flags |= HINT_FLAG_TOUCHED;
+    memset(&current, 0, sizeof(current));
+    outFile.open(fileName.c_str(), ios::out | ios::binary | ios::trunc);
+
+    string header(HINT_MAGIC, HINT_MAGIC_SIZE);
+    putFixed32(header, HINT_VERSION);
+    putFixed32(header, sC);
+    putFixed32(header, sS);
+    putFixed32(header, g);
+    putFixed32(header, blockRecords);
+    putFixed32(header, flags);
+    putFixed64(header, 0);
+    putFixed64(header, 0);
+    outFile.write(header.data(), header.size());
+}
+
+//! Destructor : closes the file if close was not called
+HintWriter::~HintWriter()
+{
+    if(outFile.is_open())
+        close();
+}
+
+//! Extend the address range of the current block
+void HintWriter::addToBlock(uint64_t addr)
+{
+    if(current.count == 0 || addr < current.firstAddress)
+        current.firstAddress = addr;
+    if(current.count == 0 || addr > current.lastAddress)
+        current.lastAddress = addr;
+}
+
+//! Append an eviction record to the current block
+/*!
+    \param er Record to encode
+ */
+void HintWriter::write(const EvictionRecord& er)
+{
+    uint64_t addr = er.getBlockAddress();
+    uint32_t size = er.getBlockSize();
+    addToBlock(addr);
+
+    putVarint(block, zigzagEncode(int64_t(addr - prevAddress)));
+    putVarint(block, size);
+    putVarint(block, zigzagEncode(int64_t(er.getInsInsert() - prevInsert)));
+    putVarint(block, zigzagEncode(int64_t(er.getInsEvict() - er.getInsInsert())));
+
+    uint32_t words = size < EVICT_BITMAP_MAX_SIZE ? size : EVICT_BITMAP_MAX_SIZE;
+    uint64_t mask = 0;
+    for(uint32_t i = 0; i < words; i++)
+    {
+        if(er.getBitmapValue(i) != 0)
+            mask |= uint64_t(1) << i;
+    }
+    putVarint(block, mask);
+    for(uint32_t i = 0; i < words && !touchedOnly; i++)
+    {
+        if(mask & (uint64_t(1) << i))
+            putVarint(block, er.getBitmapValue(i) - 1);
+    }
+
+    prevAddress = addr;
+    prevInsert = er.getInsInsert();
+    recordCount++;
+
+    if(++current.count == blockRecords)
+        flushBlock();
+}
+
+//! Append the histogram of a region to the current block
+/*!
+    \param region Region index
+    \param words Histogram of the region
+ */
+void HintWriter::write(uint64_t region, const Histogram& words)
+{
+    addToBlock(region << regionShift);
+    putVarint(block, zigzagEncode(int64_t(region - prevAddress)));
+    putVarint(block, words.entries());
+    for(uint32_t v = 0; v < words.size(); v++)
+    {
+        if(words[v] != 0)
+        {
+            putVarint(block, v);
+            putVarint(block, words[v]);
+        }
+    }
+    prevAddress = region;
+    recordCount++;
+
+    if(++current.count == blockRecords)
+        flushBlock();
+}
+
+//! Compress and write out the current block, then start a new one
+void HintWriter::flushBlock(void)
+{
+    if(current.count == 0)
+        return;
+
+    uLongf storedSize = compressBound(block.size());
+    string stored(storedSize, '\0');
+    compress2((Bytef*)&stored[0], &storedSize, (const Bytef*)block.data(), block.size(), Z_DEFAULT_COMPRESSION);
+    stored.resize(storedSize);
+
+    current.offset = outFile.tellp();
+    string header;
+    putFixed32(header, current.count);
+    putFixed32(header, stored.size());
+    putFixed32(header, block.size());
+    outFile.write(header.data(), header.size());
+    outFile.write(stored.data(), stored.size());
+    index.push_back(current);
+
+    block.clear();
+    memset(&current, 0, sizeof(current));
+    prevAddress = 0;
+    prevInsert = 0;
+}
+
+//! Flush the last block, write the block index and fill in the file header
+void HintWriter::close(void)
+{
+    flushBlock();
+
+    uint64_t indexOffset = outFile.tellp();
+    string entries(HINT_INDEX_MAGIC, HINT_MAGIC_SIZE);
+    putFixed64(entries, index.size());
+    for(vector<hintBlockInfo>::iterator it = index.begin(); it != index.end(); it++)
+    {
+        putFixed64(entries, it->offset);
+        putFixed64(entries, it->firstAddress);
+        putFixed64(entries, it->lastAddress);
+        putFixed32(entries, it->count);
+    }
+    outFile.write(entries.data(), entries.size());
+
+    string header;
+    putFixed64(header, recordCount);
+    putFixed64(header, indexOffset);
+    outFile.seekp(32);
+    outFile.write(header.data(), header.size());
+    outFile.close();
+}
+
+//! Decode the records of a raw block payload
+/*!
+    \param p Start of the raw payload
+    \param end One past the end of the raw payload
+    \param count Number of records in the block
+    \param touched TRUE if the records have no counters, HINT_FLAG_TOUCHED
+    \param out Decoded records, replaces the previous contents
+    \return FALSE if the payload is truncated or corrupt
+ */
+static bool decodeHintBlock(const unsigned char* p, const unsigned char* end, uint32_t count, bool touched, vector<EvictionRecord>& out)
+{
+    uint64_t prevAddress = 0, prevInsert = 0;
+    out.clear();
+    out.reserve(count);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint64_t addr, size, ins, life, mask, v;
+        if(!getVarint(p, end, addr) || !getVarint(p, end, size) || !getVarint(p, end, ins) || !getVarint(p, end, life) || !getVarint(p, end, mask))
+            return false;
+        if(mask >> EVICT_BITMAP_MAX_SIZE)
+            return false;
+
+        uint64_t insInsert = prevInsert + zigzagDecode(ins);
+        EvictionRecord er(prevAddress + zigzagDecode(addr), size, insInsert, insInsert + zigzagDecode(life));
+        for(uint32_t w = 0; mask != 0; w++, mask >>= 1)
+        {
+            if(!(mask & 1))
+                continue;
+            v = 0;
+            if(!touched && !getVarint(p, end, v))
+                return false;
+            er.setBitmapValue(w, v + 1);
+        }
+        out.push_back(er);
+        prevAddress = er.getBlockAddress();
+        prevInsert = insInsert;
+    }
+    return true;
+}
+
+//! Decode the records of a raw histogram block payload
+/*!
+    \param p Start of the raw payload
+    \param end One past the end of the raw payload
+    \param count Number of records in the block
+    \param out Decoded regions, replaces the previous contents
+    \return FALSE if the payload is truncated or corrupt
+ */
+static bool decodeRegionBlock(const unsigned char* p, const unsigned char* end, uint32_t count, vector<hintRegion>& out)
+{
+    uint64_t prevRegion = 0;
+    out.resize(count);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint64_t region, n, v, c;
+        if(!getVarint(p, end, region) || !getVarint(p, end, n))
+            return false;
+        out[i].region = prevRegion + zigzagDecode(region);
+        out[i].words.clear();
+        for(uint64_t k = 0; k < n; k++)
+        {
+            if(!getVarint(p, end, v) || !getVarint(p, end, c) || v > UINT32_MAX)
+                return false;
+            out[i].words.add(v, c);
+        }
+        prevRegion = out[i].region;
+    }
+    return true;
+}
+
+//! Decode the entries of a block index
+/*!
+    \param p Start of the first entry
+    \param blockCount Number of entries
+    \param index Decoded entries, replaces the previous contents
+ */
+static void decodeIndex(const unsigned char* p, uint64_t blockCount, vector<hintBlockInfo>& index)
+{
+    index.resize(blockCount);
+    for(uint64_t i = 0; i < blockCount; i++, p += HINT_INDEX_ENTRY_SIZE)
+    {
+        index[i].offset = getFixed64(p);
+        index[i].firstAddress = getFixed64(p + 8);
+        index[i].lastAddress = getFixed64(p + 16);
+        index[i].count = getFixed32(p + 24);
+    }
+}
+
+//! Uncompress the payload of a block
+/*!
+    \param stored Compressed payload
+    \param storedSize Size of the compressed payload in bytes
+    \param rawBytes Size of the raw payload in bytes, from the block header
+    \param raw Set to the raw payload
+    \return FALSE if the payload is corrupt
+ */
+static bool inflateBlock(const unsigned char* stored, uint32_t storedSize, uint32_t rawBytes, string& raw)
+{
+    raw.assign(rawBytes, '\0');
+    uLongf rawSize = rawBytes;
+    return uncompress((Bytef*)&raw[0], &rawSize, (const Bytef*)stored, storedSize) == Z_OK && rawSize == rawBytes;
+}
+
+//! Open a hint file
+/*!
+    \param fileName Path to the hint file, either format
+ */
+HintReader::HintReader(string fileName):
+    valid(false),
+    legacy(false),
+    version(0),
+    setCount(0),
+    setSize(0),
+    gran(0),
+    flags(0),
+    recordCount(0),
+    dataEnd(0),
+    pos(0)
+{
+    inFile.open(fileName.c_str(), ios::in | ios::binary);
+    if(!inFile)
+        return;
+
+    unsigned char header[HINT_HEADER_SIZE];
+    inFile.read((char*)header, HINT_HEADER_SIZE);
+    if(inFile.gcount() < HINT_MAGIC_SIZE || memcmp(header, HINT_MAGIC, HINT_MAGIC_SIZE) != 0)
+    {
+        // Raw dump, every record is a whole EvictionRecord with 32 bit counters
+        legacy = true;
+        valid = (UTIL_COUNTER_BITS == 32);
+        inFile.clear();
+        inFile.seekg(0);
+        return;
+    }
+    if(inFile.gcount() != HINT_HEADER_SIZE)
+        return;
+
+    version = getFixed32(header + 8);
+    setCount = getFixed32(header + 12);
+    setSize = getFixed32(header + 16);
+    gran = getFixed32(header + 20);
+    flags = getFixed32(header + 28);
+    recordCount = getFixed64(header + 32);
+    dataEnd = getFixed64(header + 40);
+    if(version != HINT_VERSION || dataEnd < HINT_HEADER_SIZE)
+        return;
+    valid = loadIndex();
+    inFile.clear();
+    inFile.seekg(HINT_HEADER_SIZE);
+}
+
+//! Load the block index at the end of the file
+/*!
+    \return FALSE if the index is missing or truncated
+ */
+bool HintReader::loadIndex(void)
+{
+    unsigned char indexHeader[HINT_MAGIC_SIZE + 8];
+    inFile.seekg(dataEnd);
+    if(!inFile.read((char*)indexHeader, sizeof(indexHeader)) || memcmp(indexHeader, HINT_INDEX_MAGIC, HINT_MAGIC_SIZE) != 0)
+        return false;
+    uint64_t blockCount = getFixed64(indexHeader + HINT_MAGIC_SIZE);
+
+    string entries(blockCount * HINT_INDEX_ENTRY_SIZE, '\0');
+    if(!entries.empty() && !inFile.read(&entries[0], entries.size()))
+        return false;
+
+    decodeIndex((const unsigned char*)entries.data(), blockCount, index);
+    return true;
+}
+
+//! Read and decode the block at the current position of the file
+/*!
+    \return FALSE at the end of the blocks or on a corrupt block
+ */
+bool HintReader::loadBlock(void)
+{
+    block.clear();
+    regions.clear();
+    pos = 0;
+    if(uint64_t(inFile.tellg()) >= dataEnd)
+        return false;
+
+    unsigned char header[HINT_BLOCK_HEADER_SIZE];
+    if(!inFile.read((char*)header, HINT_BLOCK_HEADER_SIZE))
+        return false;
+    uint32_t count = getFixed32(header);
+    string stored(getFixed32(header + 4), '\0');
+    uint32_t rawBytes = getFixed32(header + 8);
+    if(!stored.empty() && !inFile.read(&stored[0], stored.size()))
+        return false;
+
+    string raw;
+    if(!inflateBlock((const unsigned char*)stored.data(), stored.size(), rawBytes, raw))
+        return false;
+    const unsigned char* p = (const unsigned char*)raw.data();
+    if(isHistogram())
+        return decodeRegionBlock(p, p + raw.size(), count, regions);
+    return decodeHintBlock(p, p + raw.size(), count, isTouchedOnly(), block);
+}
+
+//! Read the next eviction record
+/*!
+    \param er Set to the next record
+    \return FALSE at the end of the file, on a corrupt or truncated record and for histogram files
+ */
+bool HintReader::next(EvictionRecord& er)
+{
+    if(!valid || isHistogram())
+        return false;
+    if(legacy)
+    {
+        // A partial record at the end of a raw dump is dropped
+        return bool(inFile.read((char*)&er, sizeof(EvictionRecord)));
+    }
+    while(pos == block.size())
+    {
+        if(!loadBlock())
+        {
+            valid = false;
+            return false;
+        }
+    }
+    er = block[pos++];
+    return true;
+}
+
+//! Read the next region of a histogram file
+/*!
+    \param region Set to the region index
+    \param words Set to the histogram of the region
+    \return FALSE at the end of the file, on a corrupt record and for eviction record files
+ */
+bool HintReader::nextRegion(uint64_t& region, Histogram& words)
+{
+    if(!valid || !isHistogram())
+        return false;
+    while(pos == regions.size())
+    {
+        if(!loadBlock())
+        {
+            valid = false;
+            return false;
+        }
+    }
+    region = regions[pos].region;
+    words = regions[pos].words;
+    pos++;
+    return true;
+}
+
+//! Position the reader at the first block that can hold an address
+/*!
+    Only the block index of a sorted file is searched, a raw dump or an unsorted file is rewound to its start.
+    \param addr Address to look for
+    \return FALSE if no record has a block address of at least addr
+ */
+bool HintReader::seek(uint64_t addr)
+{
+    inFile.clear();
+    block.clear();
+    regions.clear();
+    pos = 0;
+    if(legacy)
+    {
+        inFile.seekg(0);
+        valid = true;
+        return true;
+    }
+    if(!isSorted())
+    {
+        inFile.seekg(HINT_HEADER_SIZE);
+        valid = true;
+        return true;
+    }
+
+    uint32_t lo = 0, hi = index.size();
+    while(lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if(index[mid].lastAddress < addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if(lo == index.size())
+    {
+        valid = false;
+        return false;
+    }
+    inFile.seekg(index[lo].offset);
+    valid = true;
+    return true;
+}
+
+//! Map a hint file into memory
+/*!
+    \param fileName Path to the hint file, either format
+ */
+HintMap::HintMap(string fileName):
+    data(NULL),
+    size(0),
+    valid(false),
+    legacy(false),
+    setCount(0),
+    setSize(0),
+    gran(0),
+    flags(0),
+    recordCount(0)
+{
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if(fd < 0)
+        return;
+    struct stat st;
+    if(fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void* m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(m != MAP_FAILED)
+        {
+            data = (const unsigned char*)m;
+            size = st.st_size;
+        }
+    }
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    if(data == NULL)
+        return;
+
+    if(size < HINT_MAGIC_SIZE || memcmp(data, HINT_MAGIC, HINT_MAGIC_SIZE) != 0)
+    {
+        // Raw dump, every record is a whole EvictionRecord with 32 bit counters
+        legacy = true;
+        recordCount = size / sizeof(EvictionRecord);
+        valid = (UTIL_COUNTER_BITS == 32);
+        return;
+    }
+    if(size < HINT_HEADER_SIZE || getFixed32(data + 8) != HINT_VERSION)
+        return;
+
+    setCount = getFixed32(data + 12);
+    setSize = getFixed32(data + 16);
+    gran = getFixed32(data + 20);
+    flags = getFixed32(data + 28);
+    recordCount = getFixed64(data + 32);
+    uint64_t dataEnd = getFixed64(data + 40);
+    if(dataEnd < HINT_HEADER_SIZE || dataEnd > size - HINT_MAGIC_SIZE - 8 || memcmp(data + dataEnd, HINT_INDEX_MAGIC, HINT_MAGIC_SIZE) != 0)
+        return;
+    uint64_t blocks = getFixed64(data + dataEnd + HINT_MAGIC_SIZE);
+    if(blocks > (size - dataEnd - HINT_MAGIC_SIZE - 8) / HINT_INDEX_ENTRY_SIZE)
+        return;
+    decodeIndex(data + dataEnd + HINT_MAGIC_SIZE + 8, blocks, index);
+    for(vector<hintBlockInfo>::iterator it = index.begin(); it != index.end(); it++)
+    {
+        if(it->offset < HINT_HEADER_SIZE || it->offset > dataEnd - HINT_BLOCK_HEADER_SIZE)
+            return;
+    }
+    valid = true;
+}
+
+HintMap::~HintMap()
+{
+    if(data != NULL)
+        munmap((void*)data, size);
+}
+
+//! Number of blocks, the unit of work of decode and decodeRegions
+uint32_t HintMap::blockCount(void) const
+{
+    if(!valid)
+        return 0;
+    if(legacy)
+        return (recordCount + HINT_BLOCK_RECORDS - 1) / HINT_BLOCK_RECORDS;
+    return index.size();
+}
+
+//! Uncompress the payload of a block
+/*!
+    \param b Block number
+    \param raw Set to the raw payload
+    \param count Set to the number of records in the block
+    \return FALSE on a corrupt or truncated block
+ */
+bool HintMap::loadBlock(uint32_t b, string& raw, uint32_t& count) const
+{
+    const unsigned char* header = data + index[b].offset;
+    count = getFixed32(header);
+    uint32_t stored = getFixed32(header + 4);
+    if(stored > size - index[b].offset - HINT_BLOCK_HEADER_SIZE)
+        return false;
+    return inflateBlock(header + HINT_BLOCK_HEADER_SIZE, stored, getFixed32(header + 8), raw);
+}
+
+//! Decode the eviction records of a block
+/*!
+    Only reads the mapping, any number of threads can decode blocks at once.
+    \param b Block number, below blockCount
+    \param out Decoded records, replaces the previous contents
+    \return FALSE on a corrupt block and for histogram files
+ */
+bool HintMap::decode(uint32_t b, vector<EvictionRecord>& out) const
+{
+    out.clear();
+    if(!valid || isHistogram() || b >= blockCount())
+        return false;
+    if(legacy)
+    {
+        uint64_t first = uint64_t(b) * HINT_BLOCK_RECORDS;
+        uint64_t n = recordCount - first < HINT_BLOCK_RECORDS ? recordCount - first : HINT_BLOCK_RECORDS;
+        out.resize(n);
+        memcpy(&out[0], data + first * sizeof(EvictionRecord), n * sizeof(EvictionRecord));
+        return true;
+    }
+    string raw;
+    uint32_t count;
+    if(!loadBlock(b, raw, count))
+        return false;
+    const unsigned char* p = (const unsigned char*)raw.data();
+    return decodeHintBlock(p, p + raw.size(), count, flags & HINT_FLAG_TOUCHED, out);
+}
+
+//! Decode the regions of a block of a histogram file
+/*!
+    Only reads the mapping, any number of threads can decode blocks at once.
+    \param b Block number, below blockCount
+    \param out Decoded regions, replaces the previous contents
+    \return FALSE on a corrupt block and for eviction record files
+ */
+bool HintMap::decodeRegions(uint32_t b, vector<hintRegion>& out) const
+{
+    out.clear();
+    if(!valid || !isHistogram() || b >= blockCount())
+        return false;
+    string raw;
+    uint32_t count;
+    if(!loadBlock(b, raw, count))
+        return false;
+    const unsigned char* p = (const unsigned char*)raw.data();
+    return decodeRegionBlock(p, p + raw.size(), count, out);
+}
@@ -2,36 +2,40 @@
     \file idealcache.cpp
     \brief Source code for idealcache class
 */
+#include <cstring>
 #include "idealcache.H"
+#include "encoding.H"
 
 /*!
     \param cS Set Size in words
     \param mG Maximum Granularity of each cacheBlock
+    \param tO Tag overhead per block in words
+    \param p Replacement policy state of the set
  */
-IdealCache::IdealCache(  uint32_t cS, uint32_t mG, uint32_t tO ):
-    maxGran(mG),
-    cacheSize(cS),
+template<class Policy>
+IdealCache<Policy>::IdealCache(  uint32_t cS, uint32_t mG, uint32_t tO, const Policy& p ):
+    CacheSet(cS, mG),
     wordsInCache(0),
     tagOverhead(tO),
     QHead(NULL),
-    QTail(NULL)
+    QTail(NULL),
+    policy(p)
 {
 }
 
 //! Destructor : cleans up the cacheMap in case purge is not called
-IdealCache::~IdealCache()
+template<class Policy>
+IdealCache<Policy>::~IdealCache()
 {
-    map < uint64_t, cacheBlock* >::iterator mapIterator;
-    for( mapIterator = cacheMap.begin(); mapIterator != cacheMap.end(); mapIterator++){
-        delete mapIterator->second;
-    }
+    // The blocks still in the set are freed with the pool
 }
 
 //! Print debug information
 /*!
     Prints out the contents of the LRU Queue of this set
  */
-void IdealCache::print(void)
+template<class Policy>
+void IdealCache<Policy>::print(void)
 {
     cout << "Cache Size in Words: " << cacheSize   << endl;
     cout << "Space Used in Words: " << wordsInCache << endl;
@@ -43,7 +47,7 @@ void IdealCache::print(void)
         cout << j  << ". SA: " << hex << it->startAddress << " EA: " << it->endAddress << " Size: " << dec << it->blockSize << endl;
         for(int i=0; i < it->blockSize; i++)
         {
-            cout << it->utilizationBitmap[i] << " ";
+            cout << utilGet(it->utilizationBitmap, i) << " ";
 
         }
         cout << endl;
@@ -64,7 +68,8 @@ void IdealCache::print(void)
     \param memoryAccessSize Size of access in Bytes
     \return Latency of the operation(s) performed
  */
-int32_t IdealCache::access(memblock mb, uint64_t effectiveAddress, uint32_t memoryAccessSize)
+template<class Policy>
+int32_t IdealCache<Policy>::access(memblock mb, uint64_t effectiveAddress, uint32_t memoryAccessSize)
 {
 
     // cout  << "eA " << mb.startAddress << " Size " << dec << mb.size << endl;
@@ -73,16 +78,18 @@ int32_t IdealCache::access(memblock mb, uint64_t effectiveAddress, uint32_t memo
 
     if ( collatedHit != NULL){
         updateAccessPattern(collatedHit, effectiveAddress, memoryAccessSize);
-        cacheMap.insert(pair<uint64_t , cacheBlock*>(collatedHit->startAddress, collatedHit));
+        cacheMap.insert(collatedHit);
         pushIntoQueue(collatedHit);
+        policy.hit(collatedHit);
         splitCacheBlock(collatedHit, effectiveAddress, maxGran);
         data.hit(collatedHit);
         return SET_COLLATED_HIT_ACCESS_LATENCY;
     }
     else if ( isFullHit( mb.startAddress, mb.size ))
     {
-        cacheBlock* relocateBlock = blockHit(effectiveAddress);
+        cacheBlock* relocateBlock = blockHit(mb.startAddress);
         relocateToHead(relocateBlock);
+        policy.hit(relocateBlock);
         updateAccessPattern(relocateBlock, effectiveAddress, memoryAccessSize);
         data.hit(relocateBlock);
         return SET_HIT_ACCESS_LATENCY;
@@ -105,15 +112,16 @@ int32_t IdealCache::access(memblock mb, uint64_t effectiveAddress, uint32_t memo
     \param effectiveAddress Word aligned start address of access
     \param memoryAccessSize Size of the memory access in Bytes
  */
-int32_t IdealCache::loadMemBlock(memblock mb, uint64_t effectiveAddress, uint32_t memoryAccessSize)
+template<class Policy>
+int32_t IdealCache<Policy>::loadMemBlock(memblock mb, uint64_t effectiveAddress, uint32_t memoryAccessSize)
 {
 
     cacheBlock* pNewBlock;
     if( isCacheEmpty() )
     {
-        pNewBlock = new cacheBlock(mb.startAddress, mb.endAddress, mb.insCount);
+        pNewBlock = pool.allocate(mb.startAddress, mb.endAddress, mb.insCount);
         data.miss(pNewBlock, calculateMissBW(pNewBlock));
-        cacheMap.insert(pair< uint64_t, cacheBlock*>(pNewBlock->startAddress,pNewBlock));
+        cacheMap.insert(pNewBlock);
         pushIntoQueue(pNewBlock);
         setAccessPattern(pNewBlock, effectiveAddress, memoryAccessSize);
     }
@@ -121,9 +129,9 @@ int32_t IdealCache::loadMemBlock(memblock mb, uint64_t effectiveAddress, uint32_
     {
         if ( isFullMiss (mb) )
         {
-            pNewBlock = new cacheBlock(mb.startAddress, mb.endAddress, mb.insCount);
+            pNewBlock = pool.allocate(mb.startAddress, mb.endAddress, mb.insCount);
             data.miss(pNewBlock, calculateMissBW(pNewBlock));
-            cacheMap.insert(pair< uint64_t, cacheBlock*>(pNewBlock->startAddress,pNewBlock));
+            cacheMap.insert(pNewBlock);
             pushIntoQueue(pNewBlock);
             setAccessPattern(pNewBlock, effectiveAddress, memoryAccessSize);
         }
@@ -132,10 +140,11 @@ int32_t IdealCache::loadMemBlock(memblock mb, uint64_t effectiveAddress, uint32_
             pNewBlock = collatePartial(mb);
 
             updateAccessPattern(pNewBlock, effectiveAddress, memoryAccessSize);
-            cacheMap.insert(pair< uint64_t, cacheBlock*>(pNewBlock->startAddress,pNewBlock));
+            cacheMap.insert(pNewBlock);
             pushIntoQueue(pNewBlock);
         }
     }
+    policy.insert(pNewBlock);
     splitCacheBlock(pNewBlock, effectiveAddress, maxGran);
     return SET_MISS_ACCESS_LATENCY;
 }
@@ -146,29 +155,32 @@ int32_t IdealCache::loadMemBlock(memblock mb, uint64_t effectiveAddress, uint32_
     \param mb Requested memblock to collate into cacheBlock
     \return Pointer to collated cacheBlock
  */
-cacheBlock* IdealCache::collatePartial(memblock mb)
+template<class Policy>
+cacheBlock* IdealCache<Policy>::collatePartial(memblock mb)
 {
-    map<uint64_t, cacheBlock*>::iterator lb = lowerBound(mb.startAddress);
-    map<uint64_t, cacheBlock*>::iterator ub = lowerBound(mb.endAddress);
+    uint32_t lb, ub;
+    cacheMap.span(mb.startAddress, mb.endAddress, lb, ub);
+    cacheBlock* lBlock = cacheMap.at(lb);
+    cacheBlock* uBlock = cacheMap.at(ub);
 
     uint64_t sNew, eNew;
 
-    if( mb.startAddress > lb->second->endAddress )
+    if( mb.startAddress > lBlock->endAddress )
     {
         sNew = mb.startAddress;
     }
-    else if ( mb.startAddress < lb->second->startAddress)
+    else if ( mb.startAddress < lBlock->startAddress)
     {
         sNew = mb.startAddress;
     }
     else
     {
-        sNew = lb->second->startAddress;
+        sNew = lBlock->startAddress;
     }
 
-    if( mb.endAddress < ub->second->endAddress )
+    if( mb.endAddress < uBlock->endAddress )
     {
-        eNew = ub->second->endAddress;
+        eNew = uBlock->endAddress;
     }
     else
     {
@@ -176,7 +188,7 @@ cacheBlock* IdealCache::collatePartial(memblock mb)
     }
 
 
-    cacheBlock* collateBlock = new cacheBlock(sNew, eNew, mb.insCount);
+    cacheBlock* collateBlock = pool.allocate(sNew, eNew, mb.insCount);
 
     data.miss(collateBlock, calculateMissBW(collateBlock));
 
@@ -194,36 +206,41 @@ cacheBlock* IdealCache::collatePartial(memblock mb)
     \param collateBlock Pointer to cacheBlock which is to be processed
  */
 
-void IdealCache::processBlock(cacheBlock* collateBlock)
+template<class Policy>
+void IdealCache<Policy>::processBlock(cacheBlock* collateBlock)
 {
-    map<uint64_t, cacheBlock*>::iterator lb = lowerBound(collateBlock->startAddress);
-    map<uint64_t, cacheBlock*>::iterator ub = lowerBound(collateBlock->endAddress);
+    uint32_t lb, ub;
+    cacheMap.span(collateBlock->startAddress, collateBlock->endAddress, lb, ub);
 
     bool doDelete = false;
     while (true)
     {
-        doDelete = false;
-        for(int i = 0; i < lb->second->blockSize; i++)
+        cacheBlock* pOldBlock = cacheMap.at(lb);
+        // Copy the words the old block shares with the collated block
+        uint64_t s = max(pOldBlock->startAddress, collateBlock->startAddress);
+        uint64_t e = min(pOldBlock->endAddress, collateBlock->endAddress);
+        doDelete = ( s <= e );
+        if ( doDelete )
         {
-            uint64_t addr = lb->second->startAddress + i * WORD_SIZE;
-            if ( addr >= collateBlock->startAddress && addr <= collateBlock->endAddress)
-            {
-                int index = (addr - collateBlock->startAddress) / WORD_SIZE;
-                collateBlock->utilizationBitmap[index] = lb->second->utilizationBitmap[i];
-                doDelete = true;
-
-            }
+            utilCopy(collateBlock->utilizationBitmap, (s - collateBlock->startAddress) / WORD_SIZE,
+                     pOldBlock->utilizationBitmap, (s - pOldBlock->startAddress) / WORD_SIZE,
+                     (e - s) / WORD_SIZE + 1);
         }
+        // The collated block is as valuable to the replacement policy as the best block it absorbs
+        if ( doDelete && pOldBlock->rank > collateBlock->rank )
+            collateBlock->rank = pOldBlock->rank;
         if ( lb == ub )
         {
-            deleteFromQueue(lb->second);
-            cacheMap.erase(lb);
+            cacheMap.eraseAt(lb);
+            deleteFromQueue(pOldBlock);
             break;
         }
         else if( doDelete )
         {
-            deleteFromQueue(lb->second);
-            cacheMap.erase(lb++);
+            // The following blocks move down by one position
+            cacheMap.eraseAt(lb);
+            deleteFromQueue(pOldBlock);
+            ub--;
         }
         else
         {
@@ -239,32 +256,18 @@ void IdealCache::processBlock(cacheBlock* collateBlock)
     \param mb The memblock to be checked
     \return TRUE if none of the words in the memblock are present in the set
  */
-bool IdealCache::isFullMiss(memblock mb)
+template<class Policy>
+bool IdealCache<Policy>::isFullMiss(memblock mb)
 {
-    bool p = (lowerBound(mb.startAddress) == lowerBound(mb.endAddress));
-    bool q = (mb.endAddress < lowerBound(mb.startAddress)->second->startAddress);
-    bool r = (mb.startAddress > lowerBound(mb.endAddress)->second->endAddress);
+    uint32_t lb, ub;
+    cacheMap.span(mb.startAddress, mb.endAddress, lb, ub);
+    bool p = (lb == ub);
+    bool q = (mb.endAddress < cacheMap.at(lb)->startAddress);
+    bool r = (mb.startAddress > cacheMap.at(ub)->endAddress);
 
     return p && ( q || r );
 }
 
-//! Custom lower bound function
-/*!
-    A custom lower bound function for maps indexed with the start address of the cacheBlocks
-    \param addr The addr to find teh lower bound of
-    \return cacheMap Iterator to the lower bound
-*/
-map<uint64_t, cacheBlock*>::iterator IdealCache::lowerBound(uint64_t addr)
-{
-    map<uint64_t, cacheBlock*>::iterator lb = cacheMap.lower_bound(addr);
-    if ( lb != cacheMap.begin()){
-        if ( lb->first != addr ){
-            lb--;
-        }
-    }
-    return lb;
-}
-
 //! Split Cache Block if too large
 /*!
     The cacheBlock is checked to see if it needs to be split into smaller blocks. It needs to be split if it is greater than the maximum granularity set by the command line argument to the idealsim simulator. The split blocks are the pushed back into the queue in proper order.
@@ -274,7 +277,8 @@ map<uint64_t, cacheBlock*>::iterator IdealCache::lowerBound(uint64_t addr)
     \return TRUE if the block was split, FALSE otherwise
  */
 
-bool IdealCache::splitCacheBlock(cacheBlock* pBlock, uint64_t effectiveAddress, uint32_t size)
+template<class Policy>
+bool IdealCache<Policy>::splitCacheBlock(cacheBlock* pBlock, uint64_t effectiveAddress, uint32_t size)
 {
     //! 1. break it into pieces - store in vector
     //! 2. if effectiveAddress in range push_back else insert forward
@@ -292,12 +296,10 @@ bool IdealCache::splitCacheBlock(cacheBlock* pBlock, uint64_t effectiveAddress,
             it = chunk.begin();
             // The endAddress of the current block is either a multiple of the blocksize or equals the original block end address
             uint64_t endAddr = i != (count - 1) ? addr + (i+1)*size - WORD_SIZE : pBlock->endAddress;
-            cacheBlock* pNewBlock = new cacheBlock( addr + i*size, endAddr, pBlock->insInsert );
+            cacheBlock* pNewBlock = pool.allocate( addr + i*size, endAddr, pBlock->insInsert );
+            pNewBlock->rank = pBlock->rank;
             // Update Access Pattern of the chunk
-            for( int j = 0; j < pNewBlock->blockSize; j++)
-            {
-                pNewBlock->utilizationBitmap[j] = pBlock->utilizationBitmap[ ( i*size + j*WORD_SIZE  )/ WORD_SIZE ];
-            }
+            utilCopy(pNewBlock->utilizationBitmap, 0, pBlock->utilizationBitmap, i * size / WORD_SIZE, pNewBlock->blockSize);
             if ( effectiveAddress >= addr + i*size && effectiveAddress < addr + (i+1)*size )
                 chunk.push_back(pNewBlock);
             else
@@ -306,13 +308,13 @@ bool IdealCache::splitCacheBlock(cacheBlock* pBlock, uint64_t effectiveAddress,
 
         // Erase before insert as the Map key for 1st chunk will be the same as the original block key
 
-        deleteFromQueue(pBlock);
         cacheMap.erase(pBlock->startAddress);
+        deleteFromQueue(pBlock);
 
         for ( it = chunk.begin(); it != chunk.end(); it++)
         {
             // cout << "Chunk " << (*it)->startAddress  << " Size "<< (*it)->blockSize << endl;
-            cacheMap.insert(pair<uint64_t, cacheBlock*>((*it)->startAddress, *it ));
+            cacheMap.insert(*it);
             pushIntoQueue(*it);
         }
         return true;
@@ -323,13 +325,15 @@ bool IdealCache::splitCacheBlock(cacheBlock* pBlock, uint64_t effectiveAddress,
 
 //! Pushes a given block into the LRU Queue
 /*!
-    This method pushes a given cacheBlock into the top of the LRU Queue and also updates the words in the cache counter value.
+    This method pushes a given cacheBlock into the top of the LRU Queue and also updates the words in the cache counter value and the present words.
     \param pLoadBlock Pointer to cacheBlock to be pushed into the LRU Queue
 */
 
-void IdealCache::pushIntoQueue(cacheBlock* pLoadBlock)
+template<class Policy>
+void IdealCache<Policy>::pushIntoQueue(cacheBlock* pLoadBlock)
 {
     updateWordsInCache(pLoadBlock);
+    present.add(pLoadBlock->startAddress, pLoadBlock->endAddress);
 
     pLoadBlock->previous = NULL;
     pLoadBlock->next = QHead;
@@ -347,13 +351,15 @@ void IdealCache::pushIntoQueue(cacheBlock* pLoadBlock)
 
 //! Deletes a given block from the LRU Queue
 /*!
-    Given a pointer of a cacheBlock, this method removes the block from the LRU Queue and updates the other members of the queue. It also updates the words in cache counter and de-allocates the cacheBlock.
+    Given a pointer of a cacheBlock, this method removes the block from the LRU Queue and updates the other members of the queue. It also updates the words in cache counter and the present words and de-allocates the cacheBlock.
     \param pOldBlock Pointer to cacheBlock to remove from LRU Queue and delete
  */
 
-void IdealCache::deleteFromQueue(cacheBlock* pOldBlock)
+template<class Policy>
+void IdealCache<Policy>::deleteFromQueue(cacheBlock* pOldBlock)
 {
     wordsInCache -= ( pOldBlock->blockSize + tagOverhead );
+    present.erase(pOldBlock->startAddress, pOldBlock->endAddress);
 
     if(pOldBlock == QHead)
     {
@@ -379,7 +385,7 @@ void IdealCache::deleteFromQueue(cacheBlock* pOldBlock)
         pOldBlock->previous->next = pOldBlock->next;
         pOldBlock->next->previous = pOldBlock->previous;
     }
-    delete pOldBlock;
+    pool.release(pOldBlock);
 }
 
 
@@ -387,7 +393,8 @@ void IdealCache::deleteFromQueue(cacheBlock* pOldBlock)
 /*!
     \param relocateBlock Pointer to the cacheBlock to relocate
 */
-void IdealCache::relocateToHead(cacheBlock *relocateBlock)
+template<class Policy>
+void IdealCache<Policy>::relocateToHead(cacheBlock *relocateBlock)
 {
     if(relocateBlock != QHead)
     {
@@ -415,31 +422,20 @@ void IdealCache::relocateToHead(cacheBlock *relocateBlock)
     \param mb Requested memblock
     \return Pointer to collated block if there is a collated hit, NULL otherwise
  */
-cacheBlock* IdealCache::isCollatedHit(memblock mb)
+template<class Policy>
+cacheBlock* IdealCache<Policy>::isCollatedHit(memblock mb)
 {
     // Check for collated hit : collate and return Non NULL pointer
-    map<uint64_t, cacheBlock*>::iterator lb = lowerBound(mb.startAddress);
-    map<uint64_t, cacheBlock*>::iterator ub = lowerBound(mb.endAddress);
+    if( isCacheEmpty() )
+        return NULL;
 
-    // Check for collated hit : collate and return true
-    bool flag = true;
+    uint32_t lb, ub;
+    cacheMap.span(mb.startAddress, mb.endAddress, lb, ub);
 
-    if( lb != ub )
+    // Check for collated hit : collate and return true
+    if( lb != ub && present.all(mb.startAddress, mb.endAddress) )
     {
-        for (int i = 0; i < mb.size / WORD_SIZE; i++)
-        {
-            uint64_t addr = mb.startAddress + i * WORD_SIZE;
-            if ( !isFullHit( addr, WORD_SIZE))
-            {
-                flag = false;
-                break;
-            }
-
-        }
-        if (flag)
-        {
-            return collatePartial(mb);
-        }
+        return collatePartial(mb);
     }
 
     return NULL;
@@ -451,7 +447,8 @@ cacheBlock* IdealCache::isCollatedHit(memblock mb)
     \param memoryAccessSize Memory access size in Bytes
     \return TRUE if Full hit, FALSE otherwise
  */
-bool IdealCache::isFullHit(uint64_t effectiveAddress, uint32_t memoryAccessSize)
+template<class Policy>
+bool IdealCache<Policy>::isFullHit(uint64_t effectiveAddress, uint32_t memoryAccessSize)
 {
     if ( isCacheEmpty() )
     {
@@ -459,14 +456,14 @@ bool IdealCache::isFullHit(uint64_t effectiveAddress, uint32_t memoryAccessSize)
     }
     else
     {
-        map<uint64_t, cacheBlock*>::iterator lb = lowerBound(effectiveAddress);
-        map<uint64_t, cacheBlock*>::iterator ub = lowerBound(effectiveAddress + memoryAccessSize - WORD_SIZE);
+        uint32_t lb, ub;
+        cacheMap.span(effectiveAddress, effectiveAddress + memoryAccessSize - WORD_SIZE, lb, ub);
 
         // Check for complete overlap case : Block present in cache - Start addr is different
 
         bool p = ( lb == ub );
-        bool q = ( effectiveAddress >= lb->second->startAddress );
-        bool r = ( effectiveAddress + memoryAccessSize - WORD_SIZE <= lb->second->endAddress);
+        bool q = ( effectiveAddress >= cacheMap.at(lb)->startAddress );
+        bool r = ( effectiveAddress + memoryAccessSize - WORD_SIZE <= cacheMap.at(lb)->endAddress);
         return p && q && r;
     }
 }
@@ -477,21 +474,23 @@ bool IdealCache::isFullHit(uint64_t effectiveAddress, uint32_t memoryAccessSize)
     \param effectiveAddress Word aligned start address of the current access
     \return Pointer to the cacheBlock which contains the current access
 */
-cacheBlock* IdealCache::blockHit(uint64_t effectiveAddress)
+template<class Policy>
+cacheBlock* IdealCache<Policy>::blockHit(uint64_t effectiveAddress)
 {
-    map<uint64_t, cacheBlock*>::iterator lb = lowerBound(effectiveAddress);
-    return lb->second;
+    return cacheMap.at(cacheMap.floor(effectiveAddress));
 }
 
 
 //! Deprecated
-void IdealCache::setAccessPattern(cacheBlock* pNewBlock, uint64_t effectiveAddress, uint32_t memoryAccessSize)
+template<class Policy>
+void IdealCache<Policy>::setAccessPattern(cacheBlock* pNewBlock, uint64_t effectiveAddress, uint32_t memoryAccessSize)
 {
     pNewBlock->setAccessPattern(effectiveAddress, memoryAccessSize);
 }
 
 //! Deprecated
-void IdealCache::updateAccessPattern(cacheBlock* pNewBlock, uint64_t effectiveAddress, uint32_t memoryAccessSize)
+template<class Policy>
+void IdealCache<Policy>::updateAccessPattern(cacheBlock* pNewBlock, uint64_t effectiveAddress, uint32_t memoryAccessSize)
 {
     pNewBlock->updateAccessPattern(effectiveAddress,memoryAccessSize);
 }
@@ -500,17 +499,19 @@ void IdealCache::updateAccessPattern(cacheBlock* pNewBlock, uint64_t effectiveAd
 /*!
     \param insCount Latest instruction seen by the set / cachecontroller
  */
-void IdealCache::purge(uint64_t insCount)
+template<class Policy>
+void IdealCache<Policy>::purge(uint64_t insCount)
 {
     while(QTail != NULL){
         cacheBlock* deleteBlock = QTail;
         QTail = deleteBlock->previous;
         cacheMap.erase(deleteBlock->startAddress);
         data.evict(deleteBlock, insCount, true);
-        delete deleteBlock;
+        pool.release(deleteBlock);
     }
     QHead = QTail;
     wordsInCache = 0;
+    present.clear();
 }
 
 //! Evict a specific cacheBlock
@@ -520,7 +521,8 @@ void IdealCache::purge(uint64_t insCount)
     \param insCount The instruction count at the time of eviction
     \return TRUE if set in not empty, FALSE otherwise
  */
-bool IdealCache::evict(cacheBlock* pEvictBlock, uint64_t insCount)
+template<class Policy>
+bool IdealCache<Policy>::evict(cacheBlock* pEvictBlock, uint64_t insCount)
 {
     data.evict(pEvictBlock, insCount, false);
     cacheMap.erase(pEvictBlock->startAddress);
@@ -531,21 +533,120 @@ bool IdealCache::evict(cacheBlock* pEvictBlock, uint64_t insCount)
         return true;
 }
 
+//! Evict every block overlapping a range of addresses
+/*!
+    Used by a lower level of an inclusive hierarchy to take back the blocks of a line it evicts. Blocks only partly inside the range are evicted as a whole.
+    \param startAddress First address of the range
+    \param endAddress Last address of the range
+    \param insCount The instruction count at the time of eviction
+    \return Number of evicted blocks
+ */
+template<class Policy>
+uint32_t IdealCache<Policy>::invalidate(uint64_t startAddress, uint64_t endAddress, uint64_t insCount)
+{
+    uint32_t evicted = 0;
+    while( !isCacheEmpty() )
+    {
+        uint32_t lb, ub;
+        cacheBlock* pEvictBlock = NULL;
+        cacheMap.span(startAddress, endAddress, lb, ub);
+        for(uint32_t i = lb; i <= ub && pEvictBlock == NULL; i++)
+        {
+            if(cacheMap.at(i)->endAddress >= startAddress && cacheMap.at(i)->startAddress <= endAddress)
+                pEvictBlock = cacheMap.at(i);
+        }
+        if(pEvictBlock == NULL)
+            break;
+        evict(pEvictBlock, insCount);
+        evicted++;
+    }
+    return evicted;
+}
+
+//! Evict from the bottom of the LRU Queue until the set fits
+/*!
+    \param insCount The instruction count at the time of eviction
+ */
+template<class Policy>
+void IdealCache<Policy>::evictToFit(uint64_t insCount)
+{
+    while ( wordsInCache > cacheSize ) evict( getVictim(), insCount);
+}
+
 //! Calculate the number of words required to be brought in from lower level
 /*!
    This method calculates the number of words to be brought in from the lower level for each miss request. It is to be noted that the miss request can be a partial miss or a complete miss. We assume that it is possible for us to fetch non-contigous blocks for the lower level in a single request.
    \param pNewBlock The cacheBlock being brought into the set
    \return The number of words required from the lower level
  */
-int32_t IdealCache::calculateMissBW(cacheBlock* pNewBlock)
+template<class Policy>
+int32_t IdealCache<Policy>::calculateMissBW(cacheBlock* pNewBlock)
 {
-    int32_t bw = 0;
-    uint64_t addr = pNewBlock->startAddress;
-    for(; addr <= pNewBlock->endAddress; addr += WORD_SIZE)
+    return pNewBlock->blockSize - present.count(pNewBlock->startAddress, pNewBlock->endAddress);
+}
+
+//! Append the state of the set to a checkpoint
+/*!
+    The blocks are saved from the top to the bottom of the LRU Queue with their utilizationBitmap, followed by the DataLogger.
+    \param buf Checkpoint buffer
+ */
+template<class Policy>
+void IdealCache<Policy>::save(string& buf)
+{
+    putVarint(buf, cacheMap.size());
+    for(cacheBlock* it = QHead; it != NULL; it = it->next)
     {
-        if(!isFullHit(addr, WORD_SIZE))
-            bw++;
+        putVarint(buf, it->startAddress);
+        putVarint(buf, it->blockSize);
+        putVarint(buf, it->insInsert);
+        for(uint32_t i = 0; i < it->blockSize; i++)
+            putVarint(buf, utilGet(it->utilizationBitmap, i));
     }
+    data.save(buf);
+}
 
-    return bw;
+//! Restore the state saved by save into an empty set
+/*!
+    \param p Cursor into the checkpoint, advanced past the set
+    \param end One past the last valid byte of the checkpoint
+    \return FALSE if the checkpoint is truncated or does not fit the set
+ */
+template<class Policy>
+bool IdealCache<Policy>::load(const unsigned char*& p, const unsigned char* end)
+{
+    uint64_t n, sA, size, iC, v;
+    if(!isCacheEmpty() || !getVarint(p, end, n))
+        return false;
+    vector<cacheBlock*> lru;
+    bool ok = true;
+    for(uint64_t b = 0; ok && b < n; b++)
+    {
+        if(!getVarint(p, end, sA) || !getVarint(p, end, size) || !getVarint(p, end, iC) || size == 0)
+            break;
+        cacheBlock* pNewBlock = pool.allocate(sA, sA + (size - 1) * WORD_SIZE, iC);
+        lru.push_back(pNewBlock);
+        for(uint32_t i = 0; ok && i < size; i++)
+        {
+            ok = getVarint(p, end, v);
+            utilPut(pNewBlock->utilizationBitmap, i, v);
+        }
+    }
+    // Pushing from the bottom of the queue restores the LRU order
+    for(vector<cacheBlock*>::reverse_iterator it = lru.rbegin(); it != lru.rend(); it++)
+    {
+        cacheMap.insert(*it);
+        pushIntoQueue(*it);
+        policy.insert(*it);
+    }
+    if(!ok || lru.size() != n || wordsInCache > cacheSize)
+        return false;
+    return data.load(p, end);
 }
+
+template class IdealCache<LRUPolicy>;
+template class IdealCache<SRRIPPolicy>;
+template class IdealCache<BRRIPPolicy>;
+template class IdealCache<DRRIPPolicy>;
+template class IdealCache<LFUPolicy>;
+template class IdealCache<RandomPolicy>;
+template class IdealCache<OPTPolicy>;
@@ -5,16 +5,24 @@
 #include "idealsim.H"
 
 
-uint32_t optGran = 64, optSetCount = 4, optBinSize = 4096;
-string optFileName, optHintFilePath;
-bool optCSV = false, optHint = false, optAligned = false;
-uint64_t optWarmCount = WARM_INS, optSetSize, optSimCount = SIM_COUNT;
+uint32_t optGran = 64, optSetCount = 4, optBinSize = 4096, optDecodeThreads = 0, optChunkCount = 0, optShardCount = 0;
+uint32_t optLearnThreshold = 0, optLearnDecay = 0;
+string optFileName, optHintFilePath, optConfigFile, optCheckpointSave, optCheckpointLoad, optNextUseFile;
+bool optCSV = false, optHint = false, optAligned = false, optPipeline = false, optMissCurve = false, optReduceHints = false;
+uint64_t optWarmCount = WARM_INS, optSetSize, optSimCount = SIM_COUNT, optStartIns = 0;
+uint64_t optSamplePeriod = 0, optSampleWarm = 0, optSampleDetail = 0;
+vector<levelConfig> optLevels;
+inclusionPolicy optInclusion = INCLUSION_NONINCLUSIVE;
+replacementPolicy optReplacement = REPLACEMENT_LRU;
 
 
 /*
  * Function declarations
  */
 void setArgs(int, char** );
+bool parseLevels(string);
+bool openNextUse(const simConfig&);
+TraceReader* openTrace(string, uint64_t);
 void *tMain(void *);
 
 /*
@@ -22,13 +30,111 @@ void *tMain(void *);
  */
 CacheController *cc;
 Predictor *hint;
+Sampler *sampler = NULL;
+ShardSim *shards = NULL;
+StackDistance *mrc = NULL;
+//! Trace position of a restored checkpoint
+tracePosition resume = { 0, 0, 0 };
+bool resumed = false;
 
 
 int main(int argc, char* argv[]){
     setArgs(argc, argv);
-    cc = new CacheController( optSetCount, optSetSize , optGran , optAligned, optWarmCount);
-    hint = new Predictor(optGran, optAligned, optHintFilePath, optSetCount, optSetSize, optBinSize);
+    simConfig config = { optSetCount, optSetSize, optGran, optAligned, optWarmCount, optHintFilePath, optBinSize, optLearnThreshold, optLearnDecay, optReplacement };
+    if(!optConfigFile.empty())
+    {
+        // Multi configuration run : the trace is decoded once for all configurations
+        vector<simConfig> configs;
+        if(!MultiSim::loadConfigs(optConfigFile, config, configs))
+            return 1;
+        TraceReader* reader = openTrace(optFileName, optStartIns);
+        if(reader->good())
+        {
+            MultiSim msim(configs);
+            if(optHint && !msim.collectHints(optHintFilePath, optReduceHints ? optBinSize : 0))
+            {
+                delete reader;
+                return 1;
+            }
+            cerr << "Processing " << configs.size() << " configurations " << endl;
+            msim.run(reader, optStartIns, optSimCount);
+            msim.stats(optCSV);
+            if(optHint) msim.dumpHints();
+        }
+        else
+            cout << "File " << optFileName << " not found." << endl;
+        delete reader;
+        return 0;
+    }
+    cc = newCacheController(config);
+    newHierarchy(cc, optLevels, optInclusion);
+    // Hints are streamed to the hint file while the simulation runs
+    if(optHint && optAligned) cc->hub->collectHints(optHintFilePath, optReduceHints ? optBinSize : 0);
+    if(optChunkCount > 0)
+    {
+        // Interval parallel run : cc only collects the merged statistics
+        IntervalSim isim(config, optFileName, optChunkCount, optStartIns, optSimCount);
+        if(isim.run(cc->hub))
+        {
+            cc->hub->print(false);
+            isim.stats(false);
+            if(optHint && optAligned) cc->hub->dumpHint();
+        }
+        delete cc;
+        return 0;
+    }
+    hint = newPredictor(config);
+    connectPredictor(cc, hint);
+    if(!optNextUseFile.empty() && !openNextUse(config))
+    {
+        cout << "Could not write the next use file " << optNextUseFile << endl;
+        return 1;
+    }
+    if(optMissCurve)
+    {
+        if(!optAligned || optSamplePeriod != 0)
+        {
+            cout << "Miss ratio curves need cache aligned access mode (-a) and no sampling" << endl;
+            exit(0);
+        }
+        mrc = new StackDistance(optSetCount, optGran, optWarmCount);
+    }
+    if(optSamplePeriod != 0)
+    {
+        // Samples are measured by the Sampler, the single warmup reset would corrupt them
+        cc->execOnce = false;
+        sampler = new Sampler(cc->hub, optSamplePeriod, optSampleWarm, optSampleDetail);
+    }
+    if(!optCheckpointSave.empty() || !optCheckpointLoad.empty())
+    {
+        if(sampler != NULL || (optShardCount > 0 && !optCheckpointSave.empty()) || (mrc != NULL && !optCheckpointLoad.empty()))
+        {
+            cout << "Checkpoints can not be combined with -S, -k with -K or -r with -m" << endl;
+            exit(0);
+        }
+        if(!optCheckpointLoad.empty())
+        {
+            if(!loadCheckpoint(optCheckpointLoad, cc, hint, resume))
+                return 1;
+            resumed = true;
+        }
+        // The checkpoint carries the hints of the warmup, the restored run writes them to its own hint file
+        if(!optCheckpointSave.empty() && optHint && optAligned)
+            cc->hub->keepHints(true);
+    }
+    if(optShardCount > 0)
+    {
+        if(sampler != NULL || hint->getLearner() != NULL)
+        {
+            cout << "Sampled simulation and online learning (-l) can not be combined with -K" << endl;
+            exit(0);
+        }
+        shards = new ShardSim(cc, optShardCount);
+    }
     tMain((void*)0);
+    delete shards;
+    delete mrc;
+    delete sampler;
     delete cc;
     return 0;
 }
@@ -44,7 +150,7 @@ int main(int argc, char* argv[]){
 void setArgs(int argc, char** argv)
 {
     short c;
-    while((c = getopt(argc, argv, "f:c:t:g:e:b:d:w:s:xha?")) != -1){
+    while((c = getopt(argc, argv, "f:c:t:g:e:b:d:w:s:i:j:l:y:I:L:O:R:S:P:K:M:k:r:xhampz?")) != -1){
         switch(c){
           case 'a':
             optAligned = true;
@@ -73,6 +179,80 @@ void setArgs(int argc, char** argv)
           case 'x':
             optCSV = true;
             break;
+          case 'k':
+            optCheckpointSave = optarg;
+            break;
+          case 'r':
+            optCheckpointLoad = optarg;
+            break;
+          case 'm':
+            optMissCurve = true;
+            break;
+          case 'p':
+            optPipeline = true;
+            break;
+          case 'z':
+            optReduceHints = true;
+            break;
+          case 'l':
+            optLearnThreshold = atoi(optarg);
+            break;
+          case 'y':
+            optLearnDecay = atoi(optarg);
+            break;
+          case 'L':
+            if(!parseLevels(optarg))
+            {
+                cout << "Levels need -L Sets:SetSize[:LineSize[:Latency]] for each level below the first one, separated by commas" << endl;
+                exit(0);
+            }
+            break;
+          case 'I':
+            if(string(optarg) == "inclusive")
+                optInclusion = INCLUSION_INCLUSIVE;
+            else if(string(optarg) == "exclusive")
+                optInclusion = INCLUSION_EXCLUSIVE;
+            else if(string(optarg) == "noninclusive")
+                optInclusion = INCLUSION_NONINCLUSIVE;
+            else
+            {
+                cout << "Inclusion policy needs -I inclusive, exclusive or noninclusive" << endl;
+                exit(0);
+            }
+            break;
+          case 'R':
+            if(!findReplacement(optarg, optReplacement))
+            {
+                cout << "Replacement policy needs -R lru, srrip, brrip, drrip, lfu or random, -O for opt" << endl;
+                exit(0);
+            }
+            break;
+          case 'O':
+            optNextUseFile = optarg;
+            break;
+          case 'i':
+            optStartIns = atoll(optarg);
+            break;
+          case 'j':
+            optDecodeThreads = atoi(optarg);
+            break;
+          case 'P':
+            optChunkCount = atoi(optarg);
+            break;
+          case 'K':
+            optShardCount = atoi(optarg);
+            break;
+          case 'M':
+            optConfigFile = optarg;
+            break;
+          case 'S':
+            if(sscanf(optarg, "%llu:%llu:%llu", (unsigned long long*)&optSamplePeriod, (unsigned long long*)&optSampleWarm, (unsigned long long*)&optSampleDetail) != 3
+               || optSampleDetail == 0 || optSampleWarm + optSampleDetail > optSamplePeriod)
+            {
+                cout << "Sampling needs -S Period:Warming:Detail with Warming + Detail <= Period" << endl;
+                exit(0);
+            }
+            break;
           case 'd':
             optHintFilePath = optarg;
             optHint = true;
@@ -83,78 +263,240 @@ void setArgs(int argc, char** argv)
               cout << "Usage : " << argv[0]
                    << "\n\t-f path/to/Tracefile \n\t-s SetCount \n\t-c SetSize \n\t -g LineSize"
                    << "\n\t-w WarmUpCount -d path/to/HintFile \n\t[-x] CSV Output"
+                   << "\n\t[-z] Reduce the hints to word count histograms of -b BinSize regions"
+                   << "\n\t[-l] Threshold Learn the region hints during the run, predict a region once it has seen Threshold blocks"
+                   << "\n\t[-y] Decay Halve the learned counts every Decay evictions"
+                   << "\n\t[-p] Decode the trace on a separate thread"
+                   << "\n\t[-j] DecodeThreads for indexed binary traces \n\t[-i] StartInstruction"
+                   << "\n\t[-m] Miss ratio curve over all associativities, needs -a"
+                   << "\n\t[-k] path/to/Checkpoint Save the warm state at the end of the warmup"
+                   << "\n\t[-r] path/to/Checkpoint Continue from a saved warm state"
+                   << "\n\t[-S] Period:Warming:Detail Sampled simulation, statistics of the detailed intervals only"
+                   << "\n\t[-P] Chunks Interval parallel simulation, each chunk warmed with up to WarmUpCount instructions"
+                   << "\n\t[-K] Shards Set sharded parallel simulation"
+                   << "\n\t[-M] path/to/ConfigList Simulate one configuration per line (-s -c -g -a -R) from a single pass over the trace"
+                   << "\n\t[-L] Sets:SetSize[:LineSize[:Latency]],... Levels below the cache, the closest one first"
+                   << "\n\t[-I] inclusive|exclusive|noninclusive Inclusion policy of the levels"
+                   << "\n\t[-R] lru|srrip|brrip|drrip|lfu|random Replacement policy of the sets"
+                   << "\n\t[-O] path/to/NextUseFile Optimal (Belady) replacement, the file is written by the first run of a configuration"
                    << ""
                    << endl;
           exit(0);
         }
     }
+    // The lower levels default to the line size of the level above and can not have a smaller one
+    uint32_t gran = optGran;
+    for(vector<levelConfig>::iterator it = optLevels.begin(); it != optLevels.end(); it++)
+    {
+        if(it->gran == 0)
+            it->gran = gran;
+        if(it->gran < gran)
+        {
+            cout << "Every level of -L needs a LineSize of at least the one of the level above" << endl;
+            exit(0);
+        }
+        gran = it->gran;
+    }
+    if(!optLevels.empty() && (!optConfigFile.empty() || optChunkCount > 0 || optShardCount > 0 || optSamplePeriod != 0 || !optCheckpointSave.empty() || !optCheckpointLoad.empty()))
+    {
+        cout << "A multilevel hierarchy (-L) can not be combined with -M, -P, -K, -S, -k or -r" << endl;
+        exit(0);
+    }
+    // Checkpoints do not keep the replacement state of the blocks and the DRRIP sets share a counter
+    if((optReplacement != REPLACEMENT_LRU && (!optCheckpointSave.empty() || !optCheckpointLoad.empty())) || (optReplacement == REPLACEMENT_DRRIP && optShardCount > 0))
+    {
+        cout << "Checkpoints (-k, -r) need the lru replacement policy and -R drrip can not be combined with -K" << endl;
+        exit(0);
+    }
+    // OPT replays the accesses of a single ordinary run, in the order they were annotated
+    if(optReplacement == REPLACEMENT_OPT && optNextUseFile.empty())
+    {
+        cout << "Replacement policy opt needs -O path/to/NextUseFile" << endl;
+        exit(0);
+    }
+    if(!optNextUseFile.empty())
+    {
+        if(!optConfigFile.empty() || optChunkCount > 0 || optShardCount > 0 || optSamplePeriod != 0 || !optCheckpointSave.empty() || !optCheckpointLoad.empty() || !optLevels.empty() || optLearnThreshold > 0)
+        {
+            cout << "Optimal replacement (-O) can not be combined with -M, -P, -K, -S, -k, -r, -L or -l" << endl;
+            exit(0);
+        }
+        optReplacement = REPLACEMENT_OPT;
+    }
+}
+
+/*
+ * Open the next use file of the run for the OPT sets of cc, annotating
+ * the trace first if the file is missing or was written for another run.
+ */
+bool openNextUse(const simConfig& config)
+{
+    struct stat st;
+    nextUseKey key = { 0, optStartIns, optSimCount, optSetCount, optSetSize, optGran, optBinSize, optAligned, !optHintFilePath.empty() && !optAligned };
+    if(stat(optFileName.c_str(), &st) == 0)
+        key.traceSize = st.st_size;
+    if(cc->nextUse.open(optNextUseFile, key))
+        return true;
+    cerr << "Annotating next uses to " << optNextUseFile << endl;
+    TraceReader* reader = openTrace(optFileName, optStartIns);
+    Predictor* annotator = newPredictor(config);
+    bool ok = reader->good() && NextUse::annotate(reader, annotator, key, optNextUseFile);
+    delete annotator;
+    delete reader;
+    return ok && cc->nextUse.open(optNextUseFile, key);
+}
+
+/*
+ * Parse the levels below the first one, Sets:SetSize[:LineSize[:Latency]]
+ * separated by commas. A LineSize of 0 is resolved by setArgs.
+ */
+bool parseLevels(string levels)
+{
+    stringstream ss(levels);
+    string item;
+    while(getline(ss, item, ','))
+    {
+        levelConfig l = { 0, 0, 0, LEVEL_ACCESS_LATENCY };
+        unsigned long long size;
+        int n = sscanf(item.c_str(), "%u:%llu:%u:%u", &l.setCount, &size, &l.gran, &l.latency);
+        if(n < 2 || l.setCount == 0 || size == 0)
+            return false;
+        l.setSize = size;
+        optLevels.push_back(l);
+    }
+    return !optLevels.empty();
+}
+
+/*
+ * Open the trace with the fastest reader available for its format
+ * and move it close to startIns. Records before startIns can still
+ * be returned and have to be skipped by the caller.
+ */
+TraceReader* openTrace(string fileName, uint64_t startIns)
+{
+    if(optDecodeThreads > 0 && TraceReader::isBinaryTrace(fileName))
+    {
+        ParallelTraceReader* reader = new ParallelTraceReader(fileName, optDecodeThreads);
+        if(reader->good())
+        {
+            reader->seek(startIns);
+            return reader;
+        }
+        cerr << "No block index in " << fileName << ", decoding on a single thread" << endl;
+        delete reader;
+    }
+
+    TraceReader* reader = TraceReader::open(fileName);
+    if(startIns != 0)
+        reader->seek(startIns);
+    if(optPipeline)
+        reader = new TracePipe(reader);
+    return reader;
 }
 
 /*
  * Thread Main - Individual file processing
  */
-void *tMain(void * tArgs){
-    uint64_t insCount, insPointer, effectiveAddress, firstIns = 0, nodeid;
+//! Hands the memblocks predicted for an access to the cache
+typedef struct accessSink
+{
+    uint64_t effectiveAddress;
     uint32_t memoryAccessSize;
-    igzstream inFile;
-    char rw, tid = '0' + (uint64_t)tArgs;
+    inline void operator()(const memblock& mb)
+    {
+        if(mrc != NULL)
+            mrc->access(mb);
+        if(shards != NULL)
+            shards->access( mb , effectiveAddress, memoryAccessSize );
+        else
+            cc->access( mb , effectiveAddress, memoryAccessSize );
+    }
+} accessSink;
+
+void *tMain(void * tArgs){
+    uint64_t insCount = resume.insCount, firstIns = resume.firstIns;
+    // Records at insCount seen so far, used to save and restore the trace position
+    uint64_t sameIns = 0, prevIns = 0;
+    bool checkpoint = !optCheckpointSave.empty() && cc->execOnce;
+    traceRecord rec;
+    char tid = '0' + (uint64_t)tArgs;
     string threadLocalFilename = optFileName, ext = ".gz";
 
 
     // ext.replace(1,1,1,tid);
     // threadLocalFilename = threadLocalFilename + ext;
 
-    inFile.open(threadLocalFilename.c_str(), ios::in);
+    TraceReader* reader = openTrace(threadLocalFilename, max(optStartIns, resume.insCount));
 
     uint64_t maxAddr = 0, counter = 0;
 
-    if(inFile)
+    if(reader->good())
     {
         cerr << "Processing " << endl;
-        while(inFile >> insCount >> rw >> hex >> insPointer >> hex >> effectiveAddress >> dec >> memoryAccessSize)
+        while(reader->next(rec))
         {
+            if(rec.insCount < optStartIns)
+                continue;
+            sameIns = (rec.insCount == prevIns) ? sameIns + 1 : 1;
+            prevIns = rec.insCount;
+            if(resumed && (rec.insCount < resume.insCount || (rec.insCount == resume.insCount && sameIns <= resume.skip)))
+                continue;
             if(counter % 1000000 == 0)
                 cerr << ".";
 
-            uint64_t sA = (effectiveAddress >> int(log2(WORD_SIZE))) << int(log2(WORD_SIZE));
-            uint32_t size = 0;
-            uint64_t eA = effectiveAddress + memoryAccessSize;
-
-            if( eA % WORD_SIZE == 0 )
-            {
-                size = eA - sA;
-            }
-            else
-            {
-                eA = (eA >> int(log2(WORD_SIZE))) << int(log2(WORD_SIZE));
-                size  = eA - sA + WORD_SIZE; // Extra word for non- word aligned access
-            }
-
-            vector<memblock> blocks = hint->predict(sA, size, insCount);
+            insCount = rec.insCount;
+            uint64_t effectiveAddress = rec.effectiveAddress;
+            uint32_t memoryAccessSize = rec.memoryAccessSize;
+            uint64_t sA;
+            uint32_t size;
+            wordAlign(effectiveAddress, memoryAccessSize, sA, size);
 
-            for(vector<memblock>::iterator it = blocks.begin(); it != blocks.end(); it++)
+            if(sampler == NULL || sampler->phase(insCount) != SAMPLE_FORWARD)
             {
-                cc->access( *it , effectiveAddress, memoryAccessSize );
+                accessSink sink = { effectiveAddress, memoryAccessSize };
+                hint->predict(sA, size, insCount, sink);
             }
             counter++;
 
             if( firstIns == 0 ) firstIns = insCount;
-            if( ( optSimCount != 0 ) && ( firstIns + optSimCount < insCount ) ) break;
-
-
-            char c = '\0';
-            while ((!inFile.eof()) && (c != '\n')) {
-                inFile.get(c);
+            if(checkpoint && !cc->execOnce)
+            {
+                // The warmup ended with this record
+                tracePosition pos = { firstIns, insCount, sameIns };
+                if(!saveCheckpoint(optCheckpointSave, cc, hint, pos))
+                    cerr << "Could not write checkpoint " << optCheckpointSave << endl;
+                cc->hub->keepHints(false);
+                checkpoint = false;
             }
+            if( ( optSimCount != 0 ) && ( firstIns + optSimCount < insCount ) ) break;
         }
 
-        cc->purge(insCount);
-        cc->hub->stats(false);
-        if(optHint && optAligned) cc->hub->dumpHint(optHintFilePath);
+        if(checkpoint)
+            cerr << "Trace ended before the warmup, no checkpoint written" << endl;
+        if(sampler != NULL) sampler->finish();
+        if(shards != NULL)
+        {
+            shards->finish(insCount);
+            cc->hub->print(false);
+        }
+        else
+        {
+            cc->purge(insCount);
+            if(sampler != NULL)
+                sampler->stats(false);
+            else
+                cc->hub->stats(false);
+            cc->levelStats(false);
+            if(!optNextUseFile.empty() && !cc->nextUse.complete())
+                cerr << "The run did not match the next use file " << optNextUseFile << endl;
+        }
+        if(mrc != NULL) mrc->stats(false);
+        if(optHint && optAligned) cc->hub->dumpHint();
     }
     else
     {
         cout << "File " << threadLocalFilename << " not found." << endl;
     }
-    inFile.close();
+    delete reader;
+    return NULL;
 }
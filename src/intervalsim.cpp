@@ -0,0 +1,303 @@
+/*!
+    \file intervalsim.cpp
+    \brief Source code for the interval parallel simulation
+*/
+#include <cmath>
+#include <unordered_set>
+#include "intervalsim.H"
+#include "tracereader.H"
+
+//! IntervalSim Constructor
+/*!
+    \param c Configuration of the cache and predictor of each chunk, c.warmCount is the warmup of the sequential run and the longest warmup prefix of a chunk
+    \param fN Path to the trace
+    \param cC Number of chunks
+    \param sI First instruction to simulate
+    \param sC Number of instructions to simulate, 0 for the whole trace
+ */
+IntervalSim::IntervalSim(simConfig c, string fN, uint32_t cC, uint64_t sI, uint64_t sC):
+    config(c),
+    fileName(fN),
+    chunkCount(cC),
+    startIns(sI),
+    simCount(sC),
+    endIns(0),
+    mergedMisses(0)
+{
+}
+
+IntervalSim::~IntervalSim()
+{
+}
+
+//! Find the first and last instruction of the trace
+/*!
+    Indexed binary traces answer from their block index, other traces are read once.
+    \param first First instruction count in the trace
+    \param last Last instruction count in the trace
+    \return FALSE if the trace could not be opened or is empty
+ */
+bool IntervalSim::traceRange(uint64_t& first, uint64_t& last)
+{
+    if(TraceReader::isBinaryTrace(fileName))
+    {
+        TraceIndex index(fileName);
+        if(index.good())
+        {
+            first = index.getBlock(0).firstIns;
+            last = index.getBlock(index.getBlockCount() - 1).lastIns;
+            return true;
+        }
+    }
+
+    cerr << "No block index, reading " << fileName << " to find the chunk boundaries" << endl;
+    TraceReader* reader = TraceReader::open(fileName);
+    traceRecord rec;
+    bool found = false;
+    while(reader->next(rec))
+    {
+        if(!found) first = rec.insCount;
+        last = rec.insCount;
+        found = true;
+    }
+    delete reader;
+    return found;
+}
+
+//! Find the instruction a sequential run ends its warmup at
+/*!
+    A sequential run takes the instruction count of its first record as the start of the warmup and resets its statistics right after the first access past the WarmUpCount instructions that follow.
+    \param first First instruction to simulate
+    \param end Set to the instruction count of the record with that access
+    \return FALSE if the trace ends before the warmup does
+ */
+bool IntervalSim::warmupEnd(uint64_t first, uint64_t& end)
+{
+    TraceReader* reader = TraceReader::open(fileName);
+    reader->seek(first);
+    traceRecord rec;
+    bool found = false;
+    while(reader->next(rec))
+    {
+        if(rec.insCount >= first)
+        {
+            found = true;
+            break;
+        }
+    }
+    if(found)
+    {
+        uint64_t warmIns = rec.insCount + config.warmCount;
+        found = false;
+        reader->seek(warmIns + 1);
+        while(reader->next(rec))
+        {
+            if(rec.insCount > warmIns)
+            {
+                end = rec.insCount;
+                found = true;
+                break;
+            }
+        }
+    }
+    delete reader;
+    return found;
+}
+
+//! Simulate all chunks and merge their statistics
+/*!
+    \param target DataHub receiving the merged statistics
+    \return FALSE if the trace could not be read
+ */
+bool IntervalSim::run(DataHub* target)
+{
+    uint64_t first, last;
+    if(!traceRange(first, last))
+    {
+        cout << "File " << fileName << " not found." << endl;
+        return false;
+    }
+    if(first < startIns) first = startIns;
+    hints = target->getHintCollector();
+    endIns = (simCount != 0 && first + simCount < last) ? first + simCount : last;
+    if(endIns < first) endIns = first;
+
+    uint64_t warmEnd = 0;
+    bool warms = warmupEnd(first, warmEnd);
+
+    uint64_t length = (endIns - first) / chunkCount + 1;
+    chunks.resize(chunkCount);
+    for(uint32_t i = 0; i < chunkCount; i++)
+    {
+        intervalChunk& chunk = chunks[i];
+        chunk.sim = this;
+        chunk.id = i;
+        chunk.start = first + i * length;
+        chunk.end = chunk.start + length;
+        chunk.warmStart = (i == 0 || chunk.start - first < config.warmCount) ? first : chunk.start - config.warmCount;
+        // Measure from the start of the chunk, unless the sequential warmup is still running there
+        chunk.resetAfter = warms && warmEnd >= chunk.start;
+        chunk.resetIns = chunk.resetAfter ? warmEnd : chunk.start;
+        chunk.measuring = false;
+        chunk.warmupError = 0;
+        chunk.lastIns = 0;
+        chunk.cc = newCacheController(config);
+        // The chunk ends its warmup itself
+        chunk.cc->execOnce = false;
+        chunk.hint = newPredictor(config);
+        connectPredictor(chunk.cc, chunk.hint);
+        if(i == 0 && hints != NULL)
+            chunk.cc->hub->attachHints(hints);
+    }
+
+    cerr << "Simulating " << chunkCount << " chunks of " << length << " instructions" << endl;
+    for(uint32_t i = 0; i < chunkCount; i++)
+    {
+        if(pthread_create(&chunks[i].thread, NULL, simulate, &chunks[i]) != 0)
+        {
+            cerr << "Could not start chunk " << i << endl;
+            exit(1);
+        }
+    }
+
+    for(uint32_t i = 0; i < chunkCount; i++)
+        pthread_join(chunks[i].thread, NULL);
+
+    // A first touch in a chunk could have hit in a sequential run if the previous chunk still held the block
+    for(uint32_t i = 1; i < chunkCount; i++)
+    {
+        CacheController* prev = chunks[i-1].cc;
+        for(vector<uint64_t>::iterator it = chunks[i].coldBlocks.begin(); it != chunks[i].coldBlocks.end(); it++)
+        {
+            if(prev->getCacheSet(*it)->isFullHit(*it, WORD_SIZE))
+                chunks[i].warmupError++;
+        }
+        chunks[i].coldBlocks.clear();
+    }
+
+    for(uint32_t i = 0; i < chunkCount; i++)
+    {
+        intervalChunk& chunk = chunks[i];
+
+        // Blocks left at the end of a chunk are evicted while the next chunk runs, only the last chunk is purged
+        if(i == chunkCount - 1)
+            chunk.cc->purge(chunk.lastIns);
+        if(chunk.lastIns == 0)
+            chunk.cc->hub->firstIns = chunk.cc->hub->lastIns = 0;
+        chunk.cc->hub->setSimCount();
+        chunk.cc->hub->aggregate();
+        target->merge(chunk.cc->hub);
+        if(i == 0) target->firstIns = chunk.cc->hub->firstIns;
+        if(chunk.lastIns != 0) target->lastIns = chunk.cc->hub->lastIns;
+    }
+    for(uint32_t i = 0; i < chunkCount; i++)
+    {
+        delete chunks[i].cc;
+        delete chunks[i].hint;
+        chunks[i].cc = NULL;
+        chunks[i].hint = NULL;
+    }
+    target->simCount = target->lastIns - target->firstIns;
+    mergedMisses = target->count[COUNTER_MISS];
+    return true;
+}
+
+//! Hands the memblocks predicted for an access to the cache of a chunk and records the cold blocks
+typedef struct chunkSink
+{
+    intervalChunk* chunk;
+    //! Lines accessed so far by the chunk
+    unordered_set<uint64_t>* seen;
+    int granShift;
+    //! Record of the access
+    const traceRecord* rec;
+    inline void operator()(const memblock& mb)
+    {
+        if(!chunk->measuring && !chunk->resetAfter && mb.insCount >= chunk->resetIns)
+        {
+            chunk->cc->endWarmup();
+            chunk->measuring = true;
+        }
+        bool cold = seen->insert(mb.startAddress >> granShift).second;
+        if(cold && chunk->measuring && chunk->id != 0)
+            chunk->coldBlocks.push_back(mb.startAddress);
+        chunk->cc->access( mb , rec->effectiveAddress, rec->memoryAccessSize );
+        // The access the sequential warmup ends with is not measured either
+        if(!chunk->measuring && chunk->resetAfter && mb.insCount >= chunk->resetIns)
+        {
+            chunk->cc->endWarmup();
+            chunk->measuring = true;
+        }
+    }
+} chunkSink;
+
+//! Chunk thread main
+/*!
+    Simulates the warmup prefix and the chunk itself, and resets the statistics of the chunk at resetIns.
+    \param arg intervalChunk to simulate
+ */
+void* IntervalSim::simulate(void* arg)
+{
+    intervalChunk* chunk = (intervalChunk*)arg;
+    IntervalSim* sim = chunk->sim;
+    bool lastChunk = (chunk->id == sim->chunkCount - 1);
+    bool hinting = (chunk->id == 0);
+    unordered_set<uint64_t> seen;
+    chunkSink sink = { chunk, &seen, int(log2(sim->config.gran)), NULL };
+
+    TraceReader* reader = TraceReader::open(sim->fileName);
+    reader->seek(chunk->warmStart);
+
+    traceRecord rec;
+    while(reader->next(rec))
+    {
+        if(rec.insCount < chunk->warmStart)
+            continue;
+        if(!lastChunk && rec.insCount >= chunk->end)
+            break;
+        if(!hinting && rec.insCount >= chunk->start)
+        {
+            // Hints from the warmup prefix were already collected by the previous chunk
+            if(sim->hints != NULL)
+                chunk->cc->hub->attachHints(sim->hints);
+            hinting = true;
+        }
+
+        uint64_t sA;
+        uint32_t size;
+        wordAlign(rec.effectiveAddress, rec.memoryAccessSize, sA, size);
+        sink.rec = &rec;
+        chunk->hint->predict(sA, size, rec.insCount, sink);
+        chunk->lastIns = rec.insCount;
+
+        // Same end condition as a sequential run
+        if( lastChunk && ( sim->simCount != 0 ) && ( sim->endIns < rec.insCount ) ) break;
+    }
+    // The whole chunk was part of the warmup
+    if(!chunk->measuring)
+        chunk->cc->endWarmup();
+    delete reader;
+    return NULL;
+}
+
+//! Displays the estimate of the error caused by the per chunk warmup
+/*!
+    \param optCSV TRUE = CSV FALSE = VERBOSE
+ */
+void IntervalSim::stats(bool optCSV)
+{
+    uint64_t cold = 0;
+    for(vector<intervalChunk>::iterator it = chunks.begin(); it != chunks.end(); it++)
+        cold += it->warmupError;
+    double percent = mergedMisses ? double(cold) / mergedMisses * 100 : 0;
+
+    if(optCSV)
+    {
+        cout << chunkCount << "," << cold << "," << percent << ",";
+    }
+    else
+    {
+        cout << "Chunks: " << chunkCount << endl;
+        cout << "Warmup Error Estimate: " << cold << " misses (" << percent << " % of misses)" << endl;
+    }
+}
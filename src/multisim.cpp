@@ -0,0 +1,299 @@
+/*!
+    \file multisim.cpp
+    \brief Source code for the single pass multi configuration simulation
+*/
+#include <sched.h>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <map>
+#include "multisim.H"
+
+//! Build the caches and predictors and start a worker per configuration
+/*!
+    \param c Configurations to simulate
+ */
+MultiSim::MultiSim(const vector<simConfig>& c)
+{
+    configs.resize(c.size());
+    for(uint32_t i = 0; i < c.size(); i++)
+    {
+        multiConfig& mc = configs[i];
+        mc.sim = this;
+        mc.config = c[i];
+        mc.cc = newCacheController(c[i]);
+        mc.hint = newPredictor(c[i]);
+        connectPredictor(mc.cc, mc.hint);
+        mc.ring = new SPSCRing<sharedBatch*>(MULTI_BATCH_COUNT + 1);
+        mc.lastIns = 0;
+    }
+    for(uint32_t i = 0; i < MULTI_BATCH_COUNT; i++)
+    {
+        batches.push_back(new sharedBatch);
+        batches.back()->pending.store(0);
+    }
+}
+
+MultiSim::~MultiSim()
+{
+    for(vector<multiConfig>::iterator it = configs.begin(); it != configs.end(); it++)
+    {
+        delete it->hint;
+        delete it->cc;
+        delete it->ring;
+    }
+    for(vector<sharedBatch*>::iterator it = batches.begin(); it != batches.end(); it++)
+        delete *it;
+}
+
+//! Read the configurations to simulate
+/*!
+    One configuration per line, written with the idealsim flags -s SetCount -c SetSize -g LineSize, -a, -l Threshold, -y Decay and -R Policy. Flags that are left out take their value from defaults. Empty lines and lines starting with # are skipped.
+    \param fileName Path of the configuration list
+    \param defaults Configuration the lines are applied to
+    \param out Parsed configurations
+    \return FALSE if the file could not be read or a line could not be parsed
+ */
+bool MultiSim::loadConfigs(string fileName, const simConfig& defaults, vector<simConfig>& out)
+{
+    ifstream inFile(fileName.c_str());
+    if(!inFile)
+    {
+        cout << "Could not open configuration list " << fileName << endl;
+        return false;
+    }
+    string line;
+    uint32_t lineNo = 0;
+    while(getline(inFile, line))
+    {
+        lineNo++;
+        istringstream tokens(line);
+        string flag;
+        simConfig c = defaults;
+        bool empty = true, ok = true;
+        while(ok && tokens >> flag)
+        {
+            if(flag[0] == '#')
+                break;
+            empty = false;
+            if(flag == "-a")
+                c.aligned = true;
+            else if(flag == "-s")
+                ok = bool(tokens >> c.setCount);
+            else if(flag == "-c")
+                ok = bool(tokens >> c.setSize);
+            else if(flag == "-g")
+                ok = bool(tokens >> c.gran);
+            else if(flag == "-l")
+                ok = bool(tokens >> c.learnThreshold);
+            else if(flag == "-y")
+                ok = bool(tokens >> c.learnDecay);
+            else if(flag == "-R")
+                ok = bool(tokens >> flag) && findReplacement(flag, c.replacement) && c.replacement != REPLACEMENT_OPT;
+            else
+                ok = false;
+        }
+        if(!ok)
+        {
+            cout << fileName << ":" << lineNo << ": expected -s SetCount -c SetSize -g LineSize [-a] [-l Threshold] [-y Decay] [-R Policy]" << endl;
+            return false;
+        }
+        if(!empty)
+            out.push_back(c);
+    }
+    return true;
+}
+
+//! Hand a filled batch to every configuration
+void MultiSim::publish(sharedBatch* batch)
+{
+    if(batch != NULL)
+        batch->pending.store(configs.size(), memory_order_relaxed);
+    for(vector<multiConfig>::iterator it = configs.begin(); it != configs.end(); it++)
+    {
+        while(!it->ring->push(batch))
+            sched_yield();
+    }
+}
+
+//! Simulate the trace on every configuration
+/*!
+    The records are filtered exactly like a single configuration run, so every configuration sees the same accesses.
+    \param reader Trace to read, positioned close to startIns
+    \param startIns First instruction to simulate
+    \param simCount Number of instructions to simulate, 0 for the whole trace
+    \return FALSE if a worker could not be started
+ */
+bool MultiSim::run(TraceReader* reader, uint64_t startIns, uint64_t simCount)
+{
+    for(uint32_t i = 0; i < configs.size(); i++)
+    {
+        if(pthread_create(&configs[i].thread, NULL, simulate, &configs[i]) != 0)
+        {
+            cerr << "Could not start configuration " << i << endl;
+            exit(1);
+        }
+    }
+
+    traceRecord rec;
+    uint64_t firstIns = 0, counter = 0;
+    uint32_t slot = 0;
+    bool more = true;
+    while(more)
+    {
+        sharedBatch* batch = batches[slot];
+        slot = (slot + 1) % MULTI_BATCH_COUNT;
+        while(batch->pending.load(memory_order_acquire) != 0)
+            sched_yield();
+
+        batch->count = 0;
+        while(batch->count < TRACE_BATCH_SIZE && (more = reader->next(rec)))
+        {
+            if(rec.insCount < startIns)
+                continue;
+            if(counter % 1000000 == 0)
+                cerr << ".";
+            counter++;
+            batch->rec[batch->count++] = rec;
+
+            if( firstIns == 0 ) firstIns = rec.insCount;
+            if( ( simCount != 0 ) && ( firstIns + simCount < rec.insCount ) )
+            {
+                more = false;
+                break;
+            }
+        }
+        if(batch->count > 0)
+            publish(batch);
+    }
+    publish(NULL);
+
+    for(vector<multiConfig>::iterator it = configs.begin(); it != configs.end(); it++)
+        pthread_join(it->thread, NULL);
+    return true;
+}
+
+//! Hands the memblocks predicted for a batch to the cache of a configuration
+typedef struct batchSink
+{
+    CacheController* cc;
+    inline void operator()(const traceRecord& rec, const memblock& mb)
+    {
+        cc->access( mb , rec.effectiveAddress, rec.memoryAccessSize );
+    }
+} batchSink;
+
+//! Worker main
+/*!
+    Runs the loop of a single configuration run over the shared batches, then purges the cache and aggregates its statistics.
+    \param arg multiConfig of the worker
+ */
+void* MultiSim::simulate(void* arg)
+{
+    multiConfig* mc = (multiConfig*)arg;
+    sharedBatch* batch;
+    while(true)
+    {
+        while(!mc->ring->pop(batch))
+            sched_yield();
+        if(batch == NULL)
+            break;
+
+        batchSink sink = { mc->cc };
+        mc->hint->predictBatch(batch->rec, batch->count, sink);
+        mc->lastIns = batch->rec[batch->count - 1].insCount;
+        batch->pending.fetch_sub(1, memory_order_release);
+    }
+
+    mc->cc->purge(mc->lastIns);
+    mc->cc->hub->setSimCount();
+    mc->cc->hub->aggregate();
+    return NULL;
+}
+
+//! Display the statistics of all configurations as one table
+/*!
+    \param optCSV TRUE = CSV FALSE = VERBOSE
+ */
+void MultiSim::stats(bool optCSV)
+{
+    const char* header[] = { "Sets", "SetSize", "LineSize", "Mode", "Replacement", "Accesses", "Hits", "Misses", "Misses/1kIns", "Evictions", "Utilization", "MissBandwidth" };
+    const uint32_t columns = sizeof(header) / sizeof(header[0]);
+    const int width = 14;
+
+    for(uint32_t i = 0; i < columns; i++)
+    {
+        if(optCSV)
+            cout << header[i] << (i + 1 < columns ? "," : "");
+        else
+            cout << setw(width) << header[i];
+    }
+    cout << endl;
+
+    for(vector<multiConfig>::iterator it = configs.begin(); it != configs.end(); it++)
+    {
+        DataHub* hub = it->cc->hub;
+        uint64_t bwSum = hub->bwMap.weightedTotal();
+
+        ostringstream row[columns];
+        row[0] << it->config.setCount;
+        row[1] << it->config.setSize;
+        row[2] << it->config.gran;
+        row[3] << (it->config.aligned ? "aligned" : "ideal");
+        row[4] << replacementName(it->config.replacement);
+        row[5] << hub->count[COUNTER_ACCESS];
+        row[6] << hub->count[COUNTER_HIT];
+        row[7] << hub->count[COUNTER_MISS];
+        row[8] << double(hub->count[COUNTER_MISS])/hub->simCount * 1000;
+        row[9] << hub->count[COUNTER_EVICTION];
+        row[10] << double(hub->count[COUNTER_WORD_UTILIZATION])/(hub->count[COUNTER_WORD_UTILIZATION] + hub->count[COUNTER_WORD_WASTE]);
+        row[11] << bwSum;
+        for(uint32_t i = 0; i < columns; i++)
+        {
+            if(optCSV)
+                cout << row[i].str() << (i + 1 < columns ? "," : "");
+            else
+                cout << setw(width) << row[i].str();
+        }
+        cout << endl;
+    }
+}
+
+//! Collect the hints of every aligned configuration
+/*!
+    Refuses configurations that would write the same hint file, see DataHub::hintFileName, as their writers would overwrite each other.
+    \param hintPath Directory of the hint files, see DataHub::collectHints
+    \param regionSize Region size in Bytes to reduce the hints to, 0 to keep every eviction record
+    \return FALSE if two aligned configurations share a hint file, no hints are collected then
+ */
+bool MultiSim::collectHints(string hintPath, uint32_t regionSize)
+{
+    map<string, uint32_t> files;
+    for(uint32_t i = 0; i < configs.size(); i++)
+    {
+        const simConfig& c = configs[i].config;
+        if(!c.aligned)
+            continue;
+        string fileName = DataHub::hintFileName(hintPath, c.setCount, c.setSize);
+        if(files.count(fileName) > 0)
+        {
+            cout << "Configurations " << files[fileName] + 1 << " and " << i + 1 << " would both write the hints to " << fileName
+                 << ", hint files only tell the set count and set size apart" << endl;
+            return false;
+        }
+        files[fileName] = i;
+    }
+    for(vector<multiConfig>::iterator it = configs.begin(); it != configs.end(); it++)
+    {
+        if(it->config.aligned)
+            it->cc->hub->collectHints(hintPath, regionSize);
+    }
+    return true;
+}
+
+//! Finish the hint files of every aligned configuration
+void MultiSim::dumpHints(void)
+{
+    for(vector<multiConfig>::iterator it = configs.begin(); it != configs.end(); it++)
+        it->cc->hub->dumpHint();
+}
@@ -0,0 +1,161 @@
+/*!
+    \file nextuse.cpp
+    \brief Source code for the NextUse class
+*/
+#include <cstring>
+#include <cmath>
+#include <unordered_map>
+#include "nextuse.H"
+#include "tracereader.H"
+#include "predictor.H"
+
+//! Lines of the set accesses of a run, in access order
+typedef struct lineSink
+{
+    vector<uint64_t>* lines;
+    //! log2 of the maximum granularity
+    int granShift;
+    //! Number of sets - 1
+    uint64_t setMask;
+    //! Same split as CacheController::access : a memblock spanning two sets is two accesses
+    inline void operator()(const memblock& mb)
+    {
+        uint64_t s = mb.startAddress >> granShift;
+        lines->push_back(s);
+        if((s & setMask) != ((mb.endAddress >> granShift) & setMask))
+            lines->push_back(s + 1);
+    }
+} lineSink;
+
+//! Write the header of a next use file
+/*!
+    \param buf Buffer to append to
+    \param key Configuration of the run
+    \param count Number of accesses
+ */
+static void putHeader(string& buf, const nextUseKey& key, uint64_t count)
+{
+    buf.append(NEXTUSE_MAGIC, 8);
+    putVarint(buf, NEXTUSE_VERSION);
+    const uint64_t* k = &key.traceSize;
+    for(uint32_t i = 0; i < sizeof(nextUseKey) / sizeof(uint64_t); i++)
+        putVarint(buf, k[i]);
+    putVarint(buf, count);
+}
+
+NextUse::NextUse():
+    in(NULL),
+    buffer(NEXTUSE_BUFFER_BYTES),
+    p(NULL),
+    end(NULL),
+    position(0),
+    count(0)
+{
+}
+
+NextUse::~NextUse()
+{
+    delete in;
+}
+
+//! Move the undecoded bytes to the front of the buffer and read more
+/*!
+    \return FALSE if there is nothing left to decode
+ */
+bool NextUse::refill(void)
+{
+    uint32_t left = end - p;
+    memmove(&buffer[0], p, left);
+    in->read((char*)&buffer[left], buffer.size() - left);
+    p = &buffer[0];
+    end = p + left + in->gcount();
+    return end > p;
+}
+
+//! Open a next use file written for the same run
+/*!
+    \param fileName Path of the next use file
+    \param key Configuration of the run
+    \return FALSE if the file does not exist or was written for another run
+ */
+bool NextUse::open(string fileName, const nextUseKey& key)
+{
+    // A gzstream keeps the data buffered from its previous file, the file is opened again after an annotation
+    delete in;
+    in = new igzstream(fileName.c_str());
+    if(!in->good())
+        return false;
+    p = end = &buffer[0];
+    if(!refill() || end - p < 8 || memcmp(p, NEXTUSE_MAGIC, 8) != 0)
+        return false;
+    p += 8;
+    uint64_t version, v;
+    if(!getVarint(p, end, version) || version != NEXTUSE_VERSION)
+        return false;
+    const uint64_t* k = &key.traceSize;
+    for(uint32_t i = 0; i < sizeof(nextUseKey) / sizeof(uint64_t); i++)
+    {
+        if(!getVarint(p, end, v) || v != k[i])
+            return false;
+    }
+    position = 0;
+    return getVarint(p, end, count);
+}
+
+//! Write the next use file of a run
+/*!
+    The accesses are replayed exactly like the simulation loop does, through the Predictor, and their lines are kept in memory. A backward pass then replaces every line by the distance to the next access of the same line, 0 if there is none.
+    \param reader Trace positioned close to key.startIns
+    \param hint Predictor of the run
+    \param key Configuration of the run
+    \param fileName Path of the next use file
+    \return FALSE if the file could not be written or the run has too many accesses
+ */
+bool NextUse::annotate(TraceReader* reader, Predictor* hint, const nextUseKey& key, string fileName)
+{
+    vector<uint64_t> lines;
+    lineSink sink = { &lines, int(log2(key.gran)), key.setCount - 1 };
+    traceRecord rec;
+    uint64_t firstIns = 0;
+    while(reader->next(rec))
+    {
+        if(rec.insCount < key.startIns)
+            continue;
+        uint64_t sA;
+        uint32_t size;
+        wordAlign(rec.effectiveAddress, rec.memoryAccessSize, sA, size);
+        hint->predict(sA, size, rec.insCount, sink);
+        if( firstIns == 0 ) firstIns = rec.insCount;
+        if( ( key.simCount != 0 ) && ( firstIns + key.simCount < rec.insCount ) ) break;
+    }
+    if(lines.size() >= NEXTUSE_NEVER)
+        return false;
+
+    unordered_map<uint64_t, uint64_t> seen;
+    for(uint64_t i = lines.size(); i > 0; i--)
+    {
+        // Positions are kept plus one, 0 means the line is not accessed again
+        uint64_t& later = seen[lines[i - 1]];
+        uint64_t d = (later == 0) ? 0 : later - i;
+        later = i;
+        lines[i - 1] = d;
+    }
+
+    ogzstream out(fileName.c_str());
+    if(!out.good())
+        return false;
+    string buf;
+    putHeader(buf, key, lines.size());
+    for(vector<uint64_t>::iterator it = lines.begin(); it != lines.end(); it++)
+    {
+        putVarint(buf, *it);
+        if(buf.size() >= NEXTUSE_BUFFER_BYTES)
+        {
+            out.write(buf.data(), buf.size());
+            buf.clear();
+        }
+    }
+    out.write(buf.data(), buf.size());
+    out.close();
+    return out.good();
+}
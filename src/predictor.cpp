@@ -1,15 +1,37 @@
 #include "predictor.H"
-
-Predictor::Predictor(uint32_t mg, bool aA, string path, uint32_t setCount, uint64_t setSize, uint32_t bS):
+#include "encoding.H"
+
+//! Predictor Constructor
+/*!
+    In unaligned mode the regions are predicted from the hint file of an earlier aligned run, or learned from the evictions of the run itself when a learning threshold is given.
+    \param mg Line size in Bytes
+    \param aA TRUE for cache aligned access mode
+    \param path Directory of the hint files
+    \param setCount Number of sets
+    \param setSize Size of a set in Bytes
+    \param bS Region size in Bytes
+    \param learnThreshold Minimum number of learned runs before a region is predicted, 0 to use the hint file
+    \param learnDecay Number of evictions between two halvings of the learned counts, 0 to never decay
+ */
+Predictor::Predictor(uint32_t mg, bool aA, string path, uint32_t setCount, uint64_t setSize, uint32_t bS, uint32_t learnThreshold, uint32_t learnDecay):
     maxGran(mg),
+    granShift(int(log2(mg))),
     alignedAccess(aA),
-    binSize(bS)
+    learner(NULL),
+    binSize(bS),
+    binShift(int(log2(bS)))
 {
     if(alignedAccess)
     {
         cerr << "Using Standard aligned mode at " << maxGran << "B" <<endl;
         useHints = false;
     }
+    else if(learnThreshold > 0)
+    {
+        cerr << "Learning Region Hints during the run" << endl;
+        learner = new RegionLearner(binSize, learnThreshold, learnDecay);
+        useHints = true;
+    }
     else
     {
         stringstream sstrA, sstrB;
@@ -20,58 +42,46 @@ Predictor::Predictor(uint32_t mg, bool aA, string path, uint32_t setCount, uint6
         sstrB >> sS;
 
         path += "hint_"+sC+"_"+sS+".bin";
-        hintFile.open( path.c_str(), ios::in | ios::binary);
+        HintReader hintFile(path);
 
         /* Open Hint file and load the eviction records */
 
-        if(hintFile)
+        if(hintFile.good())
         {
             useHints = true;
-            vector<EvictionRecord> vSplitER;
-            vector<int> positions;
-            while( !hintFile.eof() )
+            if(!hintFile.isLegacy() && hintFile.getSetCount() != setCount)
+                cerr << "Warning: hints were collected with " << hintFile.getSetCount() << " sets" << endl;
+            if(hintFile.isHistogram())
             {
-                EvictionRecord *er = new EvictionRecord();
-                hintFile.read( (char *)er,sizeof(EvictionRecord));
-                bool flag = true;
-                for(int i = 0; i < er->getBlockSize(); i++)
-                {
-                    if( er->getBitmapValue(i) > 0 && flag )
-                    {
-                        positions.push_back(i);
-                        flag = false;
-                    }
-
-                    if( er->getBitmapValue(i) == 0 && !flag)
-                    {
-                        positions.push_back(i - 1);
-                        flag = true;
-                    }
-                }
-                if(!flag) positions.push_back(er->getBlockSize() - 1);
-
-                for(int i = 0; i < positions.size(); i+=2)
+                // Already reduced to the runs of every region
+                uint64_t region;
+                Histogram words;
+                uint64_t regionSize = hintFile.getRegionSize();
+                int regionShift = int(log2(regionSize));
+                if(regionSize > uint64_t(binSize))
+                    cerr << "Warning: hints were reduced to regions of " << regionSize << "B" << endl;
+                while( hintFile.nextRegion(region, words) )
                 {
-                    EvictionRecord erCopy(*er);
-                    int start = positions[i], end = positions[i+1];
-                    for(int j = 0; j < erCopy.getBlockSize(); j++)
+                    for(uint32_t wc = 0; wc < words.size(); wc++)
                     {
-                        if( !(j >= start && j <= end))
-                            erCopy.setBitmapValue(j,0);
+                        if(words[wc] != 0)
+                            process(region << regionShift, wc, words[wc]);
                     }
-                    vSplitER.push_back(erCopy);
                 }
-
-                for(int i = 0; i < vSplitER.size(); i++)
+            }
+            else
+            {
+                // Every run of accessed words of a record counts as a block of its own
+                EvictionRecord er;
+                uint32_t runs[EVICT_RUN_MAX_COUNT];
+                while( hintFile.next(er) )
                 {
-                    process(&(vSplitER[i]));
-
+                    uint32_t n = er.getRuns(runs);
+                    for(uint32_t i = 0; i < n; i++)
+                        process(er.getBlockAddress(), runs[i], 1);
                 }
-                vSplitER.clear();
-                positions.clear();
-                delete er;
             }
-            hintFile.close();
+            compileRegions();
 
             cerr << "Using Region Hints to Predict" << endl;
 
@@ -86,161 +96,155 @@ Predictor::Predictor(uint32_t mg, bool aA, string path, uint32_t setCount, uint6
 
 Predictor::~Predictor()
 {
-
-}
-
-vector<memblock> Predictor::predict(uint64_t effectiveAddress, uint32_t memoryAccessSize, uint64_t insCount)
-{
-    vector<memblock> blocks;
-
-    //  Cache Aligned Standard Implementation
-    if (alignedAccess)
-    {
-        blocks = predictAligned(effectiveAddress, memoryAccessSize, insCount);
-    }
-    // Unaligned Access - Either perfect access using only the size or using hints
-    else
-    {
-        if(useHints)
-        {
-            blocks = predictRegion(effectiveAddress, memoryAccessSize, insCount);
-        }
-        else
-        {
-            blocks.push_back(memblock(effectiveAddress, effectiveAddress + memoryAccessSize - WORD_SIZE, insCount, 1));
-        }
-    }
-
-    return blocks;
+    delete learner;
 }
 
 bool Predictor::isSpanningAccess(uint64_t effectiveAddress, uint32_t memoryAccessSize)
 {
-    uint64_t alignedStartAddress = (effectiveAddress >> int(log2(maxGran))) << int(log2(maxGran));
+    uint64_t alignedStartAddress = (effectiveAddress >> granShift) << granShift;
     /// This is -1 as the smallest access can be of size 1B
-    uint64_t alignedEndAddress = ((effectiveAddress + memoryAccessSize - 1) >> int(log2(maxGran))) << int(log2(maxGran));
+    uint64_t alignedEndAddress = ((effectiveAddress + memoryAccessSize - 1) >> granShift) << granShift;
     return alignedEndAddress != alignedStartAddress;
 }
 
-void Predictor::process(EvictionRecord* er)
+//! Count blocks of a region in the bins
+/*!
+    \param addr Address inside the region
+    \param wc Number of words of the blocks
+    \param n Number of blocks
+ */
+void Predictor::process(uint64_t addr, uint32_t wc, uint64_t n)
 {
-    uint64_t addr = er->getBlockAddress();
-    uint64_t index = addr >> int(log2(binSize));
-    uint64_t wc = wordCount(er);
-
-    if( bin.count(index) > 0)
-    {
-        if ( bin[index].count(wc) > 0)
-            bin[index][wc] += 1;
-        else
-            bin[index][wc] = 1;
-    }
-    else
-    {
-        bin[index][wc] = 1;
-    }
-
-    if(binIndexCount.count(index) > 0)
-        binIndexCount[index]++;
-    else
-        binIndexCount[index] = 1;
-
+    uint64_t index = addr >> binShift;
+    bin[index][wc] += n;
+    binIndexCount[index] += n;
 }
 
-int Predictor::wordCount( EvictionRecord* er)
+//! Compile the bins into the region table
+/*!
+    The granularity of a region is its most frequent word count below EVICT_BITMAP_MAX_SIZE, the smallest one on ties, and 1 word if the region has none. Regions with fewer than REGION_THRESHOLD records are left out. The bins are freed afterwards.
+ */
+void Predictor::compileRegions(void)
 {
-    int sum = 0;
-    for(int i=0; i < er->getBlockSize(); i++)
+    vector<regionEntry> entries;
+    for(map<uint64_t, uint64_t>::iterator it = binIndexCount.begin(); it != binIndexCount.end(); it++)
     {
-        if(er->getBitmapValue(i) > 0)
-            sum++;
-    }
-    return sum;
-}
-
-vector<memblock> Predictor::predictAligned(uint64_t effectiveAddress, uint32_t memoryAccessSize, uint64_t insCount)
-{
-    vector<memblock> blocks;
-
-    if (isSpanningAccess( effectiveAddress, memoryAccessSize))
+        if(it->second < REGION_THRESHOLD)
+            continue;
+        int gran = 1, max = 0;
+        map<uint64_t, uint64_t>& wc = bin[it->first];
+        for(int i = 0; i < EVICT_BITMAP_MAX_SIZE; i++)
         {
-            uint64_t alignedStartAddress = (effectiveAddress >> int(log2(maxGran))) << int(log2(maxGran));
-            uint64_t alignedEndAddress = ((effectiveAddress + memoryAccessSize - 1) >> int(log2(maxGran))) << int(log2(maxGran));
-
-            while(alignedStartAddress <= alignedEndAddress)
+            map<uint64_t, uint64_t>::iterator wit = wc.find(i);
+            if ( wit != wc.end() && wit->second > max )
             {
-                blocks.insert(blocks.begin(),memblock(alignedStartAddress, alignedStartAddress + maxGran - WORD_SIZE, insCount, 1));
-                alignedStartAddress += maxGran;
+                max = wit->second;
+                gran = i;
             }
         }
-        else
-        {
-            uint64_t sa = (effectiveAddress >> int(log2(maxGran))) << int(log2(maxGran));
-            uint64_t ea = sa + maxGran - WORD_SIZE;
-            blocks.push_back(memblock(sa,ea,insCount,1));
-        }
-    return blocks;
-
+        regionEntry e = { it->first, uint32_t(gran) };
+        entries.push_back(e);
+    }
+    regions.build(entries);
+    bin.clear();
+    binIndexCount.clear();
 }
 
-
-vector<memblock> Predictor::predictRegion(uint64_t effectiveAddress, uint32_t memoryAccessSize, uint64_t insCount)
+//! Size the block of an access after the hints of its region
+/*!
+    The block starts at the access and spans the number of words most often used by the evicted blocks of the region, without crossing a line boundary. An access spanning lines is loaded as it is.
+    \param effectiveAddress Word aligned start address of the access
+    \param memoryAccessSize Size of the access in Bytes
+    \param sa Start address of the block
+    \param ea End address of the block
+    \return FALSE if the region has no hints
+ */
+bool Predictor::predictRegionBlock(uint64_t effectiveAddress, uint32_t memoryAccessSize, uint64_t& sa, uint64_t& ea)
 {
-    vector<memblock> blocks;
-
     /* Static Page based predictor logic */
 
-    int gran = 1, max = 0;
-    uint64_t sa, ea;
-    uint64_t index = effectiveAddress >> int(log2(binSize));
-
+    uint32_t gran;
+    if(learner != NULL ? !learner->find(effectiveAddress >> binShift, gran) : !regions.find(effectiveAddress >> binShift, gran))
+        return false;
 
-    if ( binIndexCount.count(index) >= REGION_THRESHOLD)
+    if(isSpanningAccess(effectiveAddress, memoryAccessSize))
     {
-
-        for(int i = 0; i < EVICT_BITMAP_MAX_SIZE; i++)
-        {
-            if ( bin[index].count(i) > 0)
-            {
-                if (bin[index][i] > max )
-                {
-                    max = bin[index][i];
-                    gran = i;
-                }
-            }
-        }
-
-        if(isSpanningAccess(effectiveAddress, memoryAccessSize))
+        sa = effectiveAddress;
+        ea = effectiveAddress + memoryAccessSize - WORD_SIZE;
+    }
+    else
+    {
+        if(isSpanningAccess(effectiveAddress, gran * WORD_SIZE))
         {
             sa = effectiveAddress;
-            ea = effectiveAddress + memoryAccessSize - WORD_SIZE;
+            uint64_t alignedStart = (effectiveAddress >> granShift) << granShift;
+            ea = alignedStart + maxGran - WORD_SIZE;
         }
         else
         {
-            if(isSpanningAccess(effectiveAddress, gran * WORD_SIZE))
-            {
-                sa = effectiveAddress;
-                uint64_t alignedStart = (effectiveAddress >> int(log2(maxGran))) << int(log2(maxGran));
-                ea = alignedStart + maxGran - WORD_SIZE;
-
-            }
-            else
-            {
-                sa = effectiveAddress;
-                ea = effectiveAddress + ( (gran == 1 ? 1 : gran)- 1 ) * WORD_SIZE;
-            }
+            sa = effectiveAddress;
+            ea = effectiveAddress + ( (gran == 1 ? 1 : gran)- 1 ) * WORD_SIZE;
         }
+    }
+    return true;
+}
 
 
-        /* Logic based single load only */
-
-        blocks.push_back(memblock(sa,ea,insCount,1));
-    }
-    else
+//! Append the region table to a checkpoint
+/*!
+    Every region is saved as a bin holding a single record of its granularity, which compiles back to the same granularity. The learned regions follow, empty unless the Predictor learns online.
+    \param buf Checkpoint buffer
+ */
+void Predictor::save(string& buf)
+{
+    vector<regionEntry> entries;
+    regions.list(entries);
+    buf.push_back(useHints ? 1 : 0);
+    putVarint(buf, entries.size());
+    for(vector<regionEntry>::iterator it = entries.begin(); it != entries.end(); it++)
     {
-        // Fall back to aligned
-        blocks = predictAligned(effectiveAddress,memoryAccessSize,insCount);
+        putVarint(buf, it->region);
+        putVarint(buf, 1);
+        putVarint(buf, 1);
+        putVarint(buf, it->gran);
+        putVarint(buf, 1);
     }
-    return blocks;
+    RegionLearner empty(binSize, 1, 0);
+    (learner != NULL ? learner : &empty)->save(buf);
 }
 
+//! Replace the region table with the bins saved by save
+/*!
+    Checkpoints of older versions end before the learned regions.
+    \param p Cursor into the checkpoint, advanced past the bins
+    \param end One past the last valid byte of the checkpoint
+    \return FALSE if the checkpoint is truncated
+ */
+bool Predictor::load(const unsigned char*& p, const unsigned char* end)
+{
+    uint64_t n, m, index, wc, v;
+    if(p >= end)
+        return false;
+    useHints = ((*p++ != 0) || learner != NULL) && !alignedAccess;
+    bin.clear();
+    binIndexCount.clear();
+    if(!getVarint(p, end, n))
+        return false;
+    for(uint64_t i = 0; i < n; i++)
+    {
+        if(!getVarint(p, end, index) || !getVarint(p, end, v) || !getVarint(p, end, m))
+            return false;
+        binIndexCount[index] = v;
+        for(uint64_t j = 0; j < m; j++)
+        {
+            if(!getVarint(p, end, wc) || !getVarint(p, end, v))
+                return false;
+            bin[index][wc] = v;
+        }
+    }
+    compileRegions();
+    if(p == end)
+        return true;
+    RegionLearner ignored(binSize, 1, 0);
+    return (learner != NULL ? learner : &ignored)->load(p, end);
+}
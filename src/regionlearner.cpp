@@ -0,0 +1,164 @@
+/*!
+    \file regionlearner.cpp
+    \brief Source code for the RegionLearner class
+*/
+#include <cstring>
+#include <cmath>
+#include "regionlearner.H"
+#include "encoding.H"
+
+//! RegionLearner Constructor
+/*!
+    \param binSize Region size in Bytes, a power of two
+    \param t Minimum number of runs before a region is predicted
+    \param d Number of learned evictions between two halvings of the counts, 0 to never decay
+ */
+RegionLearner::RegionLearner(uint32_t binSize, uint32_t t, uint32_t d):
+    binShift(int(log2(binSize))),
+    threshold(t),
+    decay(d),
+    learned(0)
+{
+}
+
+//! Halve the counts of a region once for every decay epoch passed since it was last used
+void RegionLearner::age(learnedRegion& r)
+{
+    uint64_t e = epoch();
+    if(r.epoch == e)
+        return;
+    uint64_t shift = e - r.epoch;
+    r.epoch = e;
+    r.total = 0;
+    for(uint32_t i = 0; i <= EVICT_BITMAP_MAX_SIZE; i++)
+    {
+        r.count[i] = shift >= 64 ? 0 : r.count[i] >> shift;
+        r.total += r.count[i];
+    }
+    update(r);
+}
+
+//! Recompute the granularity of a region
+/*!
+    Same rule as Predictor::compileRegions : the most frequent run length below EVICT_BITMAP_MAX_SIZE, the smallest one on ties, 1 word if there is none.
+ */
+void RegionLearner::update(learnedRegion& r)
+{
+    uint64_t max = 0;
+    r.gran = 1;
+    for(uint32_t i = 0; i < EVICT_BITMAP_MAX_SIZE; i++)
+    {
+        if(r.count[i] > max)
+        {
+            max = r.count[i];
+            r.gran = i;
+        }
+    }
+}
+
+//! Learn from an eviction
+/*!
+    \param er Record of the evicted block
+ */
+void RegionLearner::add(const EvictionRecord& er)
+{
+    uint32_t runs[EVICT_RUN_MAX_COUNT];
+    uint32_t n = er.getRuns(runs);
+    learned++;
+    if(n == 0)
+        return;
+
+    uint64_t index = er.getBlockAddress() >> binShift;
+    unordered_map<uint64_t, learnedRegion>::iterator it = regions.find(index);
+    if(it == regions.end())
+    {
+        learnedRegion r;
+        memset(&r, 0, sizeof(r));
+        r.epoch = epoch();
+        it = regions.insert(make_pair(index, r)).first;
+    }
+    learnedRegion& r = it->second;
+    age(r);
+    for(uint32_t i = 0; i < n; i++)
+        r.count[runs[i]]++;
+    r.total += n;
+    update(r);
+}
+
+//! Look up the granularity learned for a region
+/*!
+    \param region Region index
+    \param gran Set to the granularity of the region
+    \return FALSE if the region has seen fewer runs than the threshold
+ */
+bool RegionLearner::find(uint64_t region, uint32_t& gran)
+{
+    unordered_map<uint64_t, learnedRegion>::iterator it = regions.find(region);
+    if(it == regions.end())
+        return false;
+    age(it->second);
+    if(it->second.total < threshold)
+        return false;
+    gran = it->second.gran;
+    return true;
+}
+
+//! Append the learned state to a checkpoint
+/*!
+    \param buf Checkpoint buffer
+ */
+void RegionLearner::save(string& buf)
+{
+    putVarint(buf, learned);
+    putVarint(buf, regions.size());
+    for(unordered_map<uint64_t, learnedRegion>::iterator it = regions.begin(); it != regions.end(); it++)
+    {
+        learnedRegion& r = it->second;
+        age(r);
+        uint32_t n = 0;
+        for(uint32_t i = 0; i <= EVICT_BITMAP_MAX_SIZE; i++)
+            n += (r.count[i] != 0);
+        putVarint(buf, it->first);
+        putVarint(buf, n);
+        for(uint32_t i = 0; i <= EVICT_BITMAP_MAX_SIZE; i++)
+        {
+            if(r.count[i] != 0)
+            {
+                putVarint(buf, i);
+                putVarint(buf, r.count[i]);
+            }
+        }
+    }
+}
+
+//! Replace the learned state with the one saved by save
+/*!
+    \param p Cursor into the checkpoint, advanced past the learned state
+    \param end One past the last valid byte of the checkpoint
+    \return FALSE if the checkpoint is truncated
+ */
+bool RegionLearner::load(const unsigned char*& p, const unsigned char* end)
+{
+    uint64_t n, index, m, len, v;
+    regions.clear();
+    if(!getVarint(p, end, learned) || !getVarint(p, end, n))
+        return false;
+    for(uint64_t i = 0; i < n; i++)
+    {
+        learnedRegion r;
+        memset(&r, 0, sizeof(r));
+        r.epoch = epoch();
+        if(!getVarint(p, end, index) || !getVarint(p, end, m))
+            return false;
+        for(uint64_t j = 0; j < m; j++)
+        {
+            if(!getVarint(p, end, len) || !getVarint(p, end, v) || len > EVICT_BITMAP_MAX_SIZE)
+                return false;
+            r.count[len] = v;
+            r.total += v;
+        }
+        update(r);
+        regions[index] = r;
+    }
+    return true;
+}
@@ -0,0 +1,91 @@
+/*!
+    \file sampler.cpp
+    \brief Source code for the Sampler class
+*/
+#include "sampler.H"
+
+//! Sampler Constructor
+/*!
+    \param h DataHub of the simulated cache
+    \param p Sampling unit length in instructions
+    \param w Functional warming length in instructions
+    \param d Detailed interval length in instructions, w + d must not exceed p
+ */
+Sampler::Sampler(DataHub* h, uint64_t p, uint64_t w, uint64_t d):
+    hub(h),
+    period(p),
+    warmLength(w),
+    detailLength(d),
+    origin(0),
+    unit(0),
+    measuring(false),
+    measured(0)
+{
+}
+
+//! Get the phase of an instruction
+/*!
+    Opens and closes the detailed intervals as the instruction count moves through the sampling units. Must be called with non decreasing instruction counts.
+    \param insCount Instruction count of the current access
+    \return Phase the access belongs to
+ */
+samplePhase Sampler::phase(uint64_t insCount)
+{
+    if(origin == 0)
+        origin = insCount;
+
+    uint64_t u = (insCount - origin) / period;
+    uint64_t offset = (insCount - origin) % period;
+
+    if(measuring && (u != unit || offset < period - detailLength))
+        close();
+
+    if(offset >= period - detailLength)
+    {
+        if(!measuring)
+        {
+            // Drop the counts of the warming accesses
+            hub->reset();
+            hub->snapshot(start);
+            unit = u;
+            measuring = true;
+        }
+        return SAMPLE_DETAIL;
+    }
+    if(offset >= period - detailLength - warmLength)
+        return SAMPLE_WARM;
+    return SAMPLE_FORWARD;
+}
+
+//! Record the open detailed interval as a sample
+void Sampler::close(void)
+{
+    hubSnapshot end;
+    hub->snapshot(end);
+    hub->addSample(start, end, detailLength);
+    hub->aggregate();
+    hub->reset();
+    measured += detailLength;
+    measuring = false;
+}
+
+//! Close the last detailed interval at the end of the run
+/*!
+    Must be called before the cache is purged so the purge evictions are not counted in the last sample. A detailed interval cut short by the end of the trace is dropped.
+ */
+void Sampler::finish(void)
+{
+    measuring = false;
+}
+
+//! Displays the statistics of the detailed intervals
+/*!
+    Replaces DataHub::stats for a sampled run. The counts the sets gathered outside of the detailed intervals, the cache purge included, are dropped and the instruction count is the total length of the recorded detailed intervals.
+    \param optCSV TRUE = CSV FALSE = VERBOSE
+ */
+void Sampler::stats(bool optCSV)
+{
+    hub->reset();
+    hub->simCount = measured;
+    hub->print(optCSV);
+}
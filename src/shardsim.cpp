@@ -0,0 +1,206 @@
+/*!
+    \file shardsim.cpp
+    \brief Source code for the set sharded parallel simulation
+*/
+#include <sched.h>
+#include "shardsim.H"
+
+//! Split the sets and start the workers
+/*!
+    \param c Cache to simulate, its sets must not be accessed by anyone else until finish returns
+    \param shardCount Number of worker threads, at most one per set
+ */
+ShardSim::ShardSim(CacheController* c, uint32_t shardCount):
+    cc(c),
+    owner(c->setCount),
+    purgeIns(0),
+    running(false)
+{
+    if(shardCount > cc->setCount) shardCount = cc->setCount;
+    if(shardCount == 0) shardCount = 1;
+
+    shards.resize(shardCount);
+    for(uint32_t s = 0; s < shardCount; s++)
+    {
+        cacheShard& shard = shards[s];
+        uint64_t begin = cc->setCount * s / shardCount, end = cc->setCount * (s + 1) / shardCount;
+        for(uint64_t i = begin; i < end; i++)
+        {
+            shard.sets.push_back(cc->cacheSet[i]);
+            owner[i] = s;
+        }
+        shard.sim = this;
+        shard.fullRing = new SPSCRing<shardBatch*>(SHARD_DEPTH);
+        shard.freeRing = new SPSCRing<shardBatch*>(SHARD_DEPTH);
+        for(uint32_t j = 0; j < SHARD_DEPTH; j++)
+        {
+            shard.batches.push_back(new shardBatch);
+            shard.freeRing->push(shard.batches.back());
+        }
+        shard.freeRing->pop(shard.current);
+        shard.current->count = 0;
+        shard.current->reset = false;
+        shard.current->last = false;
+        shard.part = NULL;
+    }
+    for(uint32_t s = 0; s < shardCount; s++)
+    {
+        if(pthread_create(&shards[s].thread, NULL, simulate, &shards[s]) != 0)
+        {
+            cerr << "Could not start shard " << s << endl;
+            exit(1);
+        }
+    }
+    running = true;
+}
+
+//! Stop the workers if finish was not called and free the shards
+ShardSim::~ShardSim()
+{
+    if(running)
+        finish(cc->hub->lastIns);
+    for(vector<cacheShard>::iterator it = shards.begin(); it != shards.end(); it++)
+    {
+        for(vector<shardBatch*>::iterator bit = it->batches.begin(); bit != it->batches.end(); bit++)
+            delete *bit;
+        delete it->fullRing;
+        delete it->freeRing;
+        delete it->part;
+    }
+}
+
+//! Request for a Cache Access
+/*!
+    Does the bookkeeping of CacheController::access on the routing thread and queues the set accesses to the shards.
+    \param mb Block of memory requested by the Predictor
+    \param effectiveAddress The word aligned start address of the current access
+    \param memoryAccessSize The size of the current access in terms of Bytes
+ */
+void ShardSim::access(memblock mb, uint64_t effectiveAddress, uint32_t memoryAccessSize)
+{
+    if (cc->firstInsGate)
+    {
+        cc->hub->firstIns = mb.insCount;
+        cc->firstInsGate = false;
+    }
+    cc->hub->lastIns = mb.insCount;
+
+    if (cc->isSetSpanningBlock(mb))
+    {
+        uint64_t nStartAddr = cc->getSplitAddress(mb);
+        memblock blockA(mb.startAddress, nStartAddr - WORD_SIZE, mb.insCount, mb.modCount);
+        memblock blockB(nStartAddr, mb.endAddress, mb.insCount, mb.modCount);
+        route(cc->getIndex(blockA.startAddress), blockA, effectiveAddress, memoryAccessSize);
+        route(cc->getIndex(blockB.startAddress), blockB, effectiveAddress, memoryAccessSize);
+    }
+    else
+    {
+        route(cc->getIndex(mb.startAddress), mb, effectiveAddress, memoryAccessSize);
+    }
+
+    if(cc->hub->firstIns + cc->optWarmCount < mb.insCount && cc->execOnce)
+    {
+        for(vector<cacheShard>::iterator it = shards.begin(); it != shards.end(); it++)
+        {
+            it->current->reset = true;
+            flush(*it);
+        }
+        cc->execOnce = false;
+    }
+}
+
+//! Queue a set access to the shard owning the set
+void ShardSim::route(int index, const memblock& mb, uint64_t effectiveAddress, uint32_t memoryAccessSize)
+{
+    cacheShard& shard = shards[owner[index]];
+    shardAccess& acc = shard.current->acc[shard.current->count++];
+    acc.index = index;
+    acc.startAddress = mb.startAddress;
+    acc.endAddress = mb.endAddress;
+    acc.insCount = mb.insCount;
+    acc.modCount = mb.modCount;
+    acc.effectiveAddress = effectiveAddress;
+    acc.memoryAccessSize = memoryAccessSize;
+    if(shard.current->count == SHARD_BATCH_SIZE)
+        flush(shard);
+}
+
+//! Hand the current batch of a shard to its worker and start a new one
+void ShardSim::flush(cacheShard& shard)
+{
+    while(!shard.fullRing->push(shard.current))
+        sched_yield();
+    while(!shard.freeRing->pop(shard.current))
+        sched_yield();
+    shard.current->count = 0;
+    shard.current->reset = false;
+    shard.current->last = false;
+}
+
+//! Drain the shards, purge the sets and reduce the statistics
+/*!
+    The sets are purged and aggregated by the workers, the partial statistics are merged into the DataHub of the cache. The DataHub is ready to be printed afterwards.
+    \param insCount Instruction count of the purge, see CacheController::purge
+ */
+void ShardSim::finish(uint64_t insCount)
+{
+    if(!running)
+        return;
+    purgeIns = insCount;
+    for(vector<cacheShard>::iterator it = shards.begin(); it != shards.end(); it++)
+    {
+        it->current->last = true;
+        while(!it->fullRing->push(it->current))
+            sched_yield();
+        it->current = NULL;
+    }
+
+    DataHub* hub = cc->hub;
+    for(vector<cacheShard>::iterator it = shards.begin(); it != shards.end(); it++)
+    {
+        pthread_join(it->thread, NULL);
+        hub->merge(it->part);
+    }
+    hub->simCount = hub->lastIns - hub->firstIns;
+    running = false;
+}
+
+//! Worker main
+/*!
+    \param arg cacheShard of the worker
+ */
+void* ShardSim::simulate(void* arg)
+{
+    cacheShard* shard = (cacheShard*)arg;
+    CacheController* cc = shard->sim->cc;
+    bool last = false;
+    while(!last)
+    {
+        shardBatch* batch;
+        while(!shard->fullRing->pop(batch))
+            sched_yield();
+
+        for(uint32_t i = 0; i < batch->count; i++)
+        {
+            shardAccess& acc = batch->acc[i];
+            cc->accessSet(acc.index, memblock(acc.startAddress, acc.endAddress, acc.insCount, acc.modCount), acc.effectiveAddress, acc.memoryAccessSize);
+        }
+        if(batch->reset)
+        {
+            for(vector<CacheSet*>::iterator it = shard->sets.begin(); it != shard->sets.end(); it++)
+                (*it)->data.reset();
+        }
+        last = batch->last;
+        shard->freeRing->push(batch);
+    }
+
+    for(vector<CacheSet*>::iterator it = shard->sets.begin(); it != shard->sets.end(); it++)
+        (*it)->purge(shard->sim->purgeIns);
+
+    shard->part = new DataHub(&shard->sets);
+    shard->part->firstIns = cc->hub->firstIns;
+    shard->part->lastIns = cc->hub->lastIns;
+    shard->part->setSimCount();
+    shard->part->aggregate();
+    return NULL;
+}
@@ -0,0 +1,167 @@
+/*!
+    \file stackdistance.cpp
+    \brief Source code for the StackDistance class
+*/
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include "stackdistance.H"
+
+//! StackDistance Constructor
+/*!
+    \param sC Number of sets, a power of two
+    \param g Line size in Bytes
+    \param w Number of instructions for cache warmup
+ */
+StackDistance::StackDistance(uint64_t sC, uint32_t g, uint64_t w):
+    setCount(sC),
+    gran(g),
+    warmCount(w),
+    sets(sC),
+    coldMisses(0),
+    accessCount(0),
+    firstIns(0),
+    warm(false)
+{
+    for(vector<stackSet>::iterator it = sets.begin(); it != sets.end(); it++)
+    {
+        it->tree.assign(STACK_MIN_TIMES + 1, 0);
+        it->now = 0;
+    }
+}
+
+//! Record the access of a line
+/*!
+    \param mb Line requested by the Predictor in cache aligned access mode
+ */
+void StackDistance::access(const memblock& mb)
+{
+    if(accessCount == 0 && !warm)
+        firstIns = mb.insCount;
+
+    uint64_t line = mb.startAddress >> int(log2(gran));
+    uint32_t d = distance(sets[line & (setCount - 1)], line);
+    if(d == UINT32_MAX)
+        coldMisses++;
+    else
+    {
+        if(d >= histogram.size())
+            histogram.resize(d + 1, 0);
+        histogram[d]++;
+    }
+    accessCount++;
+
+    if(!warm && firstIns + warmCount < mb.insCount)
+    {
+        reset();
+        warm = true;
+    }
+}
+
+//! Move a line to the top of the stack of its set
+/*!
+    \param s Stack of the set
+    \param line Line address
+    \return Number of other lines accessed since the previous access of the line, UINT32_MAX for the first access
+ */
+uint32_t StackDistance::distance(stackSet& s, uint64_t line)
+{
+    if(s.now + 1 == s.tree.size())
+        compact(s);
+
+    uint32_t size = s.tree.size();
+    uint32_t d = UINT32_MAX;
+    unordered_map<uint64_t, uint32_t>::iterator it = s.last.find(line);
+    if(it != s.last.end())
+    {
+        // Marks up to and including the previous access
+        uint32_t before = 0;
+        for(uint32_t i = it->second + 1; i > 0; i -= i & (-i))
+            before += s.tree[i];
+        d = s.last.size() - before;
+        for(uint32_t i = it->second + 1; i < size; i += i & (-i))
+            s.tree[i]--;
+        it->second = s.now;
+    }
+    else
+        s.last[line] = s.now;
+
+    for(uint32_t i = s.now + 1; i < size; i += i & (-i))
+        s.tree[i]++;
+    s.now++;
+    return d;
+}
+
+//! Renumber the timestamps of a set from zero
+/*!
+    The tree is rebuilt with room for at least as many new timestamps as there are lines in the set, so the cost is amortized over the accesses.
+    \param s Stack of the set
+ */
+void StackDistance::compact(stackSet& s)
+{
+    vector<pair<uint32_t, uint64_t> > order;
+    order.reserve(s.last.size());
+    for(unordered_map<uint64_t, uint32_t>::iterator it = s.last.begin(); it != s.last.end(); it++)
+        order.push_back(make_pair(it->second, it->first));
+    sort(order.begin(), order.end());
+
+    uint32_t size = STACK_MIN_TIMES;
+    while(size < 2 * order.size()) size <<= 1;
+    s.tree.assign(size + 1, 0);
+    for(uint32_t t = 0; t < order.size(); t++)
+    {
+        s.last[order[t].second] = t;
+        s.tree[t + 1] = 1;
+    }
+    for(uint32_t i = 1; i <= size; i++)
+    {
+        uint32_t parent = i + (i & (-i));
+        if(parent <= size)
+            s.tree[parent] += s.tree[i];
+    }
+    s.now = order.size();
+}
+
+//! Clear the histogram at the end of the warmup, the stacks are kept
+void StackDistance::reset(void)
+{
+    histogram.clear();
+    coldMisses = 0;
+    accessCount = 0;
+}
+
+//! Misses of a set of A lines
+/*!
+    \param assoc Number of lines per set
+    \return Number of accesses with a stack distance of at least assoc
+ */
+uint64_t StackDistance::misses(uint64_t assoc)
+{
+    uint64_t m = coldMisses;
+    for(uint64_t d = assoc; d < histogram.size(); d++)
+        m += histogram[d];
+    return m;
+}
+
+//! Displays the miss ratio curve
+/*!
+    One point per power of two associativity, up to the first associativity at which only cold misses are left.
+    \param optCSV TRUE = CSV FALSE = VERBOSE
+ */
+void StackDistance::stats(bool optCSV)
+{
+    if(!optCSV)
+        cout << "Miss Ratio Curve (" << setCount << " sets, " << gran << " B lines):" << endl;
+    for(uint64_t assoc = 1; assoc <= STACK_MAX_ASSOC; assoc <<= 1)
+    {
+        uint64_t m = misses(assoc);
+        double ratio = accessCount ? double(m) / accessCount : 0;
+        double sizeKB = double(assoc * gran * setCount) / 1024;
+        if(optCSV)
+            cout << assoc << "," << m << "," << ratio << ",";
+        else
+            cout << "Associativity: " << assoc << " Size: " << sizeKB << " KB Misses: " << m << " Miss Ratio: " << ratio << endl;
+        if(assoc >= histogram.size())
+            break;
+    }
+}
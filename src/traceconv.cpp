@@ -0,0 +1,81 @@
+/*!
+    \file traceconv.cpp
+    \brief Convert a gzipped text trace into the binary trace format read by idealsim
+ */
+#include <iostream>
+#include <unistd.h>
+#include <cstdlib>
+#include <string>
+#include "tracereader.H"
+#include "tracewriter.H"
+
+using namespace std;
+
+string optInFile, optOutFile;
+uint32_t optBlockRecords = TRACE_BLOCK_RECORDS;
+
+void setArgs(int argc, char* argv[])
+{
+    short c;
+    while( (c = getopt(argc, argv, "f:o:b:h?")) != -1)
+    {
+        switch(c)
+        {
+          case 'f':
+            optInFile = optarg;
+            break;
+          case 'o':
+            optOutFile = optarg;
+            break;
+          case 'b':
+            optBlockRecords = atoi(optarg);
+            break;
+          case 'h':
+          case '?':
+          default:
+            cout << "Usage : " << argv[0]
+                 << "\n\t-f path/to/Tracefile.gz \n\t-o path/to/Output \n\t[-b] RecordsPerBlock"
+                 << endl;
+            exit(0);
+        }
+    }
+    if(optInFile.empty() || optOutFile.empty() || optBlockRecords == 0)
+    {
+        cout << "Usage : " << argv[0] << " -f path/to/Tracefile.gz -o path/to/Output" << endl;
+        exit(0);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    setArgs(argc, argv);
+
+    TraceReader* reader = TraceReader::open(optInFile);
+    if(!reader->good())
+    {
+        cout << "File " << optInFile << " not found." << endl;
+        delete reader;
+        return 1;
+    }
+
+    TraceWriter writer(optOutFile, optBlockRecords);
+    if(!writer.good())
+    {
+        cout << "Could not open " << optOutFile << " for writing." << endl;
+        delete reader;
+        return 1;
+    }
+
+    traceRecord rec;
+    while(reader->next(rec))
+    {
+        writer.write(rec);
+        if(writer.getRecordCount() % 1000000 == 0)
+            cerr << ".";
+    }
+    writer.close();
+    delete reader;
+
+    cerr << endl << "Converted " << writer.getRecordCount() << " records" << endl;
+    return 0;
+}
@@ -0,0 +1,267 @@
+/*!
+    \file tracepipe.cpp
+    \brief Source code for the pipelined trace decoder
+*/
+#include <sched.h>
+#include "tracepipe.H"
+
+//! Start the decode thread
+/*!
+    \param src Reader to run on the decode thread, owned by the TracePipe from now on
+    \param depth Number of batches in flight
+ */
+TracePipe::TracePipe(TraceReader* src, uint32_t depth):
+    source(src),
+    fullRing(depth),
+    freeRing(depth),
+    current(NULL),
+    pos(0),
+    valid(false)
+{
+    done.store(false);
+    stop.store(false);
+    if(source->good())
+    {
+        for(uint32_t i = 0; i < depth; i++)
+        {
+            batches.push_back(new traceBatch);
+            freeRing.push(batches.back());
+        }
+        valid = (pthread_create(&producer, NULL, produce, this) == 0);
+    }
+}
+
+//! Stop the decode thread and free the batches
+TracePipe::~TracePipe()
+{
+    if(valid)
+    {
+        stop.store(true);
+        pthread_join(producer, NULL);
+    }
+    for(vector<traceBatch*>::iterator it = batches.begin(); it != batches.end(); it++)
+        delete *it;
+    delete source;
+}
+
+//! Decode thread main
+/*!
+    Fills free batches from the source reader and hands them to the simulation thread until the trace ends or the pipe is stopped.
+    \param arg Pointer to the TracePipe
+ */
+void* TracePipe::produce(void* arg)
+{
+    TracePipe* pipe = (TracePipe*)arg;
+    bool more = true;
+    while(more)
+    {
+        traceBatch* batch;
+        while(!pipe->freeRing.pop(batch))
+        {
+            if(pipe->stop.load(memory_order_relaxed)) return NULL;
+            sched_yield();
+        }
+
+        batch->count = 0;
+        while(batch->count < TRACE_BATCH_SIZE && (more = pipe->source->next(batch->rec[batch->count])))
+            batch->count++;
+
+        while(!pipe->fullRing.push(batch))
+        {
+            if(pipe->stop.load(memory_order_relaxed)) return NULL;
+            sched_yield();
+        }
+    }
+    pipe->done.store(true, memory_order_release);
+    return NULL;
+}
+
+//! Get the next filled batch
+/*!
+    The batch must be handed back with releaseBatch once it has been consumed.
+    \return Next batch, NULL at the end of the trace
+ */
+traceBatch* TracePipe::nextBatch(void)
+{
+    traceBatch* batch;
+    if(!valid)
+        return NULL;
+    while(!fullRing.pop(batch))
+    {
+        if(done.load(memory_order_acquire))
+        {
+            // The last batch may have been pushed just before done was set
+            return fullRing.pop(batch) ? batch : NULL;
+        }
+        sched_yield();
+    }
+    return batch;
+}
+
+//! Return a consumed batch to the decode thread
+void TracePipe::releaseBatch(traceBatch* batch)
+{
+    freeRing.push(batch);
+}
+
+//! Read the next record from the current batch
+bool TracePipe::next(traceRecord& rec)
+{
+    while(current == NULL || pos == current->count)
+    {
+        if(current != NULL)
+            releaseBatch(current);
+        current = nextBatch();
+        pos = 0;
+        if(current == NULL)
+            return false;
+    }
+    rec = current->rec[pos++];
+    return true;
+}
+
+//! Argument of a ParallelTraceReader decode thread
+typedef struct decodeArgs
+{
+    ParallelTraceReader* reader;
+    uint32_t id;
+} decodeArgs;
+
+//! Open an indexed binary trace for multithreaded decode
+/*!
+    The decode threads are started on the first call to next, so seek can still move the start.
+    \param fileName Path to a version 2 binary trace
+    \param tC Number of decode threads
+ */
+ParallelTraceReader::ParallelTraceReader(string fileName, uint32_t tC):
+    index(fileName),
+    threadCount(tC > 0 ? tC : 1),
+    startBlock(0),
+    nextBlock(0),
+    current(NULL),
+    pos(0),
+    started(false)
+{
+    stop.store(false);
+}
+
+//! Stop the decode threads and free the blocks
+ParallelTraceReader::~ParallelTraceReader()
+{
+    stop.store(true);
+    for(vector<pthread_t>::iterator it = workers.begin(); it != workers.end(); it++)
+        pthread_join(*it, NULL);
+    for(uint32_t i = 0; i < fullRing.size(); i++)
+    {
+        delete fullRing[i];
+        delete freeRing[i];
+    }
+    for(vector<decodedBlock*>::iterator it = slots.begin(); it != slots.end(); it++)
+        delete *it;
+}
+
+//! Start from the block containing an instruction
+/*!
+    \param insCount Instruction count to seek to
+    \return FALSE once reading has started
+ */
+bool ParallelTraceReader::seek(uint64_t insCount)
+{
+    if(started || !index.good())
+        return false;
+    startBlock = index.findBlock(insCount);
+    return true;
+}
+
+//! Allocate the rings and start the decode threads
+void ParallelTraceReader::start(void)
+{
+    started = true;
+    nextBlock = startBlock;
+    for(uint32_t i = 0; i < threadCount; i++)
+    {
+        fullRing.push_back(new SPSCRing<decodedBlock*>(TRACE_DECODE_DEPTH));
+        freeRing.push_back(new SPSCRing<decodedBlock*>(TRACE_DECODE_DEPTH));
+        for(uint32_t j = 0; j < TRACE_DECODE_DEPTH; j++)
+        {
+            slots.push_back(new decodedBlock);
+            freeRing[i]->push(slots.back());
+        }
+    }
+    for(uint32_t i = 0; i < threadCount; i++)
+    {
+        pthread_t t;
+        decodeArgs* args = new decodeArgs;
+        args->reader = this;
+        args->id = i;
+        if(pthread_create(&t, NULL, decode, args) == 0)
+            workers.push_back(t);
+        else
+        {
+            delete args;
+            cerr << "Could not start decode thread " << i << endl;
+            exit(1);
+        }
+    }
+}
+
+//! Decode thread main
+/*!
+    \param arg decodeArgs of the thread, freed by the thread
+ */
+void* ParallelTraceReader::decode(void* arg)
+{
+    ParallelTraceReader* reader = ((decodeArgs*)arg)->reader;
+    uint32_t id = ((decodeArgs*)arg)->id;
+    delete (decodeArgs*)arg;
+
+    for(uint32_t b = reader->startBlock + id; b < reader->index.getBlockCount(); b += reader->threadCount)
+    {
+        decodedBlock* slot;
+        while(!reader->freeRing[id]->pop(slot))
+        {
+            if(reader->stop.load(memory_order_relaxed)) return NULL;
+            sched_yield();
+        }
+        slot->ok = reader->index.readBlock(b, slot->rec);
+        reader->fullRing[id]->push(slot);
+        if(!slot->ok)
+            break;
+    }
+    return NULL;
+}
+
+//! Read the next record in trace order
+bool ParallelTraceReader::next(traceRecord& rec)
+{
+    if(!started)
+    {
+        if(!index.good())
+            return false;
+        start();
+    }
+    while(current == NULL || pos == current->rec.size())
+    {
+        if(current != NULL)
+        {
+            freeRing[(nextBlock - 1 - startBlock) % threadCount]->push(current);
+            current = NULL;
+        }
+        if(nextBlock >= index.getBlockCount())
+            return false;
+
+        SPSCRing<decodedBlock*>* ring = fullRing[(nextBlock - startBlock) % threadCount];
+        while(!ring->pop(current))
+            sched_yield();
+        nextBlock++;
+        pos = 0;
+        if(!current->ok)
+        {
+            cerr << "Corrupt trace block " << nextBlock - 1 << endl;
+            nextBlock = index.getBlockCount();
+            return false;
+        }
+    }
+    rec = current->rec[pos++];
+    return true;
+}
@@ -0,0 +1,318 @@
+/*!
+    \file tracereader.cpp
+    \brief Source code for the trace readers
+
+    Binary trace layout, all fixed width fields are little endian:
+    - File header (TRACE_HEADER_SIZE bytes): magic "CUSIMTRC", uint32 version, uint32 records per block, uint64 record count, uint64 file offset of the block index (0 if there is none)
+    - Blocks, each with a header of uint32 record count, uint32 stored payload size and, from version 2 on, uint32 raw payload size. Version 2 payloads are zlib compressed.
+    - Version 2 only: the block index, magic "CUSIMIDX", uint64 block count, then per block uint64 offset, uint64 first instruction, uint64 last instruction, uint64 first record, uint32 record count
+    Records inside a raw payload are varints: zigzag insCount delta, R/W byte, zigzag instruction pointer delta, zigzag effective address delta, access size.
+    Deltas are relative to the previous record of the same block so that every block can be decoded on its own.
+ */
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "tracereader.H"
+#include "encoding.H"
+
+//! Open a trace file with the reader matching its format
+/*!
+    \param fileName Path to a gzipped text trace or a binary trace
+    \return Reader for the trace, check good() before use
+ */
+TraceReader* TraceReader::open(string fileName)
+{
+    if(isBinaryTrace(fileName))
+        return new BinaryTraceReader(fileName);
+    return new TextTraceReader(fileName);
+}
+
+//! Check for the binary trace magic string
+/*!
+    \param fileName Path to the trace file
+    \return TRUE if the file starts with TRACE_MAGIC
+ */
+bool TraceReader::isBinaryTrace(string fileName)
+{
+    ifstream f(fileName.c_str(), ios::in | ios::binary);
+    char magic[TRACE_MAGIC_SIZE];
+    if(!f.read(magic, TRACE_MAGIC_SIZE))
+        return false;
+    return memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_SIZE) == 0;
+}
+
+TextTraceReader::TextTraceReader(string fileName)
+{
+    inFile.open(fileName.c_str(), ios::in);
+}
+
+TextTraceReader::~TextTraceReader()
+{
+    inFile.close();
+}
+
+//! Parse the next line of the text trace
+bool TextTraceReader::next(traceRecord& rec)
+{
+    if(!(inFile >> rec.insCount >> rec.rw >> hex >> rec.insPointer >> hex >> rec.effectiveAddress >> dec >> rec.memoryAccessSize))
+        return false;
+
+    char c = '\0';
+    while ((!inFile.eof()) && (c != '\n')) {
+        inFile.get(c);
+    }
+    return true;
+}
+
+//! Decode the records of a raw block payload
+/*!
+    \param p Start of the raw payload
+    \param end One past the end of the raw payload
+    \param count Number of records in the block
+    \param out Decoded records, replaces the previous contents
+    \return FALSE if the payload is truncated
+ */
+bool decodeTraceBlock(const unsigned char* p, const unsigned char* end, uint32_t count, vector<traceRecord>& out)
+{
+    traceRecord prev;
+    memset(&prev, 0, sizeof(prev));
+    out.resize(count);
+    for(uint32_t i = 0; i < count; i++)
+    {
+        uint64_t ins, pc, addr, size;
+        if(!getVarint(p, end, ins) || p >= end)
+            return false;
+        char rw = char(*p++);
+        if(!getVarint(p, end, pc) || !getVarint(p, end, addr) || !getVarint(p, end, size))
+            return false;
+
+        traceRecord& rec = out[i];
+        rec.insCount = prev.insCount + zigzagDecode(ins);
+        rec.rw = rw;
+        rec.insPointer = prev.insPointer + zigzagDecode(pc);
+        rec.effectiveAddress = prev.effectiveAddress + zigzagDecode(addr);
+        rec.memoryAccessSize = uint32_t(size);
+        prev = rec;
+    }
+    return true;
+}
+
+//! Decode a stored block, inflating it first for version 2 traces
+/*!
+    \param version Format version of the trace
+    \param count Number of records in the block
+    \param stored Stored payload
+    \param rawBytes Size of the raw payload (version 2 only)
+    \param out Decoded records
+    \return FALSE on a corrupt block
+ */
+static bool decodeStoredBlock(uint32_t version, uint32_t count, const string& stored, uint32_t rawBytes, vector<traceRecord>& out)
+{
+    const unsigned char* p = (const unsigned char*)stored.data();
+    if(version == TRACE_VERSION_PLAIN)
+        return decodeTraceBlock(p, p + stored.size(), count, out);
+
+    string raw(rawBytes, '\0');
+    uLongf rawSize = rawBytes;
+    if(uncompress((Bytef*)&raw[0], &rawSize, p, stored.size()) != Z_OK || rawSize != rawBytes)
+        return false;
+    p = (const unsigned char*)raw.data();
+    return decodeTraceBlock(p, p + raw.size(), count, out);
+}
+
+//! Read and decode the block at the current position of a stream
+/*!
+    \param in Stream positioned at a block header
+    \param version Format version of the trace
+    \param out Decoded records
+    \return FALSE at the end of the stream or on a corrupt block
+ */
+bool readTraceBlock(istream& in, uint32_t version, vector<traceRecord>& out)
+{
+    unsigned char header[TRACE_BLOCK_HEADER_SIZE];
+    uint32_t headerSize = version == TRACE_VERSION_PLAIN ? TRACE_BLOCK_HEADER_SIZE_PLAIN : TRACE_BLOCK_HEADER_SIZE;
+    if(!in.read((char*)header, headerSize))
+        return false;
+
+    uint32_t count = getFixed32(header);
+    string stored(getFixed32(header + 4), '\0');
+    uint32_t rawBytes = version == TRACE_VERSION_PLAIN ? stored.size() : getFixed32(header + 8);
+    if(!stored.empty() && !in.read(&stored[0], stored.size()))
+        return false;
+    return decodeStoredBlock(version, count, stored, rawBytes, out);
+}
+
+//! Load the block index of a binary trace
+/*!
+    \param fileName Path to the binary trace
+ */
+TraceIndex::TraceIndex(string fileName):
+    version(0),
+    recordCount(0)
+{
+    fd = ::open(fileName.c_str(), O_RDONLY);
+    if(fd < 0)
+        return;
+
+    unsigned char header[TRACE_HEADER_SIZE];
+    if(pread(fd, header, TRACE_HEADER_SIZE, 0) != TRACE_HEADER_SIZE || memcmp(header, TRACE_MAGIC, TRACE_MAGIC_SIZE) != 0)
+        return;
+    version = getFixed32(header + 8);
+    recordCount = getFixed64(header + 16);
+    uint64_t indexOffset = getFixed64(header + 24);
+    if(version != TRACE_VERSION || indexOffset == 0)
+        return;
+
+    unsigned char indexHeader[TRACE_MAGIC_SIZE + 8];
+    if(pread(fd, indexHeader, sizeof(indexHeader), indexOffset) != sizeof(indexHeader) || memcmp(indexHeader, TRACE_INDEX_MAGIC, TRACE_MAGIC_SIZE) != 0)
+        return;
+    uint64_t blockCount = getFixed64(indexHeader + TRACE_MAGIC_SIZE);
+
+    string entries(blockCount * TRACE_INDEX_ENTRY_SIZE, '\0');
+    if(!entries.empty() && pread(fd, &entries[0], entries.size(), indexOffset + sizeof(indexHeader)) != ssize_t(entries.size()))
+        return;
+
+    const unsigned char* p = (const unsigned char*)entries.data();
+    blocks.resize(blockCount);
+    for(uint64_t i = 0; i < blockCount; i++, p += TRACE_INDEX_ENTRY_SIZE)
+    {
+        blocks[i].offset = getFixed64(p);
+        blocks[i].firstIns = getFixed64(p + 8);
+        blocks[i].lastIns = getFixed64(p + 16);
+        blocks[i].firstRecord = getFixed64(p + 24);
+        blocks[i].count = getFixed32(p + 32);
+    }
+}
+
+TraceIndex::~TraceIndex()
+{
+    if(fd >= 0)
+        close(fd);
+}
+
+//! Find the first block that can contain an instruction
+/*!
+    \param insCount Instruction count to look for
+    \return Index of the first block whose last instruction is at least insCount, getBlockCount() if there is none
+ */
+uint32_t TraceIndex::findBlock(uint64_t insCount)
+{
+    uint32_t lo = 0, hi = blocks.size();
+    while(lo < hi)
+    {
+        uint32_t mid = (lo + hi) / 2;
+        if(blocks[mid].lastIns < insCount)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+//! Decode a single block
+/*!
+    Uses positional reads only, so it is safe to call from several threads at once.
+    \param i Index of the block
+    \param out Decoded records
+    \return FALSE on a read error or a corrupt block
+ */
+bool TraceIndex::readBlock(uint32_t i, vector<traceRecord>& out)
+{
+    unsigned char header[TRACE_BLOCK_HEADER_SIZE];
+    if(pread(fd, header, TRACE_BLOCK_HEADER_SIZE, blocks[i].offset) != TRACE_BLOCK_HEADER_SIZE)
+        return false;
+
+    string stored(getFixed32(header + 4), '\0');
+    if(!stored.empty() && pread(fd, &stored[0], stored.size(), blocks[i].offset + TRACE_BLOCK_HEADER_SIZE) != ssize_t(stored.size()))
+        return false;
+    return decodeStoredBlock(version, getFixed32(header), stored, getFixed32(header + 8), out);
+}
+
+//! Open a binary trace and check the header
+/*!
+    \param fileName Path to the binary trace
+ */
+BinaryTraceReader::BinaryTraceReader(string fileName):
+    version(0),
+    recordCount(0),
+    dataEnd(0),
+    pos(0),
+    index(NULL),
+    valid(false)
+{
+    inFile.open(fileName.c_str(), ios::in | ios::binary);
+    unsigned char header[TRACE_HEADER_SIZE];
+    if(inFile.read((char*)header, TRACE_HEADER_SIZE) && memcmp(header, TRACE_MAGIC, TRACE_MAGIC_SIZE) == 0)
+    {
+        version = getFixed32(header + 8);
+        recordCount = getFixed64(header + 16);
+        dataEnd = getFixed64(header + 24);
+        if(version == TRACE_VERSION_PLAIN || version == TRACE_VERSION)
+            valid = true;
+        else
+            cerr << "Unsupported binary trace version " << version << endl;
+    }
+
+    if(valid && dataEnd != 0)
+    {
+        index = new TraceIndex(fileName);
+        if(!index->good())
+        {
+            delete index;
+            index = NULL;
+        }
+    }
+}
+
+BinaryTraceReader::~BinaryTraceReader()
+{
+    delete index;
+    inFile.close();
+}
+
+//! Read the next block of records into memory
+/*!
+    \return FALSE at the end of the trace or on a corrupt block
+ */
+bool BinaryTraceReader::loadBlock(void)
+{
+    pos = 0;
+    do
+    {
+        if(dataEnd != 0 && uint64_t(inFile.tellg()) >= dataEnd)
+            return false;
+        if(!readTraceBlock(inFile, version, block))
+            return false;
+    } while(block.empty());
+    return true;
+}
+
+//! Decode the next record
+bool BinaryTraceReader::next(traceRecord& rec)
+{
+    if(!valid)
+        return false;
+    if(pos == block.size() && !loadBlock())
+        return false;
+    rec = block[pos++];
+    return true;
+}
+
+//! Jump to the block containing an instruction using the block index
+/*!
+    \param insCount Instruction count to seek to
+    \return TRUE if the trace has an index and the reader moved
+ */
+bool BinaryTraceReader::seek(uint64_t insCount)
+{
+    if(index == NULL)
+        return false;
+
+    uint32_t b = index->findBlock(insCount);
+    block.clear();
+    pos = 0;
+    inFile.clear();
+    inFile.seekg(b < index->getBlockCount() ? index->getBlock(b).offset : dataEnd);
+    return true;
+}
@@ -0,0 +1,114 @@
+/*!
+    \file tracewriter.cpp
+    \brief Source code for the binary TraceWriter
+*/
+#include <cstring>
+#include <zlib.h>
+#include "tracewriter.H"
+#include "encoding.H"
+
+//! Create a binary trace and write a placeholder header
+/*!
+    \param fileName Path of the binary trace to create
+    \param bR Number of records per block
+ */
+TraceWriter::TraceWriter(string fileName, uint32_t bR):
+    blockRecords(bR),
+    recordCount(0)
+{
+    memset(&prev, 0, sizeof(prev));
+    memset(&current, 0, sizeof(current));
+    outFile.open(fileName.c_str(), ios::out | ios::binary | ios::trunc);
+
+    string header(TRACE_MAGIC, TRACE_MAGIC_SIZE);
+    putFixed32(header, TRACE_VERSION);
+    putFixed32(header, blockRecords);
+    putFixed64(header, 0);
+    putFixed64(header, 0);
+    outFile.write(header.data(), header.size());
+}
+
+//! Destructor : closes the file if close was not called
+TraceWriter::~TraceWriter()
+{
+    if(outFile.is_open())
+        close();
+}
+
+//! Append a record to the current block
+/*!
+    \param rec Record to encode
+ */
+void TraceWriter::write(const traceRecord& rec)
+{
+    if(current.count == 0)
+    {
+        current.firstIns = rec.insCount;
+        current.lastIns = rec.insCount;
+        current.firstRecord = recordCount;
+    }
+    if(rec.insCount > current.lastIns)
+        current.lastIns = rec.insCount;
+
+    putVarint(block, zigzagEncode(int64_t(rec.insCount - prev.insCount)));
+    block.push_back(rec.rw);
+    putVarint(block, zigzagEncode(int64_t(rec.insPointer - prev.insPointer)));
+    putVarint(block, zigzagEncode(int64_t(rec.effectiveAddress - prev.effectiveAddress)));
+    putVarint(block, rec.memoryAccessSize);
+    prev = rec;
+    recordCount++;
+
+    if(++current.count == blockRecords)
+        flushBlock();
+}
+
+//! Compress and write out the current block, then start a new one
+void TraceWriter::flushBlock(void)
+{
+    if(current.count == 0)
+        return;
+
+    uLongf storedSize = compressBound(block.size());
+    string stored(storedSize, '\0');
+    compress2((Bytef*)&stored[0], &storedSize, (const Bytef*)block.data(), block.size(), Z_DEFAULT_COMPRESSION);
+    stored.resize(storedSize);
+
+    current.offset = outFile.tellp();
+    string header;
+    putFixed32(header, current.count);
+    putFixed32(header, stored.size());
+    putFixed32(header, block.size());
+    outFile.write(header.data(), header.size());
+    outFile.write(stored.data(), stored.size());
+    index.push_back(current);
+
+    block.clear();
+    memset(&current, 0, sizeof(current));
+    memset(&prev, 0, sizeof(prev));
+}
+
+//! Flush the last block, write the block index and fill in the file header
+void TraceWriter::close(void)
+{
+    flushBlock();
+
+    uint64_t indexOffset = outFile.tellp();
+    string entries(TRACE_INDEX_MAGIC, TRACE_MAGIC_SIZE);
+    putFixed64(entries, index.size());
+    for(vector<traceBlockInfo>::iterator it = index.begin(); it != index.end(); it++)
+    {
+        putFixed64(entries, it->offset);
+        putFixed64(entries, it->firstIns);
+        putFixed64(entries, it->lastIns);
+        putFixed64(entries, it->firstRecord);
+        putFixed32(entries, it->count);
+    }
+    outFile.write(entries.data(), entries.size());
+
+    string header;
+    putFixed64(header, recordCount);
+    putFixed64(header, indexOffset);
+    outFile.seekp(16);
+    outFile.write(header.data(), header.size());
+    outFile.close();
+}